@@ -0,0 +1,56 @@
+//! @file Cancellation.cpp
+#include "Cancellation.hpp"
+
+#include <limits>
+
+namespace svg
+{
+    RenderCancelled::RenderCancelled(const char *what)
+        : std::runtime_error(what)
+    {
+    }
+
+    CancellationToken::CancellationToken(const CancellationToken *parent)
+        : parent_(parent), cancelled_(false), deadline_(std::numeric_limits<Clock::rep>::max())
+    {
+    }
+
+    void CancellationToken::cancel()
+    {
+        cancelled_ = true;
+    }
+
+    void CancellationToken::set_deadline(Clock::time_point deadline)
+    {
+        deadline_ = deadline.time_since_epoch().count();
+    }
+
+    void CancellationToken::set_timeout(std::chrono::milliseconds timeout)
+    {
+        set_deadline(Clock::now() + timeout);
+    }
+
+    bool CancellationToken::cancelled() const
+    {
+        if (cancelled_ || (parent_ != nullptr && parent_->cancelled()))
+        {
+            return true;
+        }
+        Clock::rep deadline = deadline_;
+        return deadline != std::numeric_limits<Clock::rep>::max() &&
+               Clock::now().time_since_epoch().count() >= deadline;
+    }
+
+    void CancellationToken::check() const
+    {
+        check_cancelled(parent_);
+        if (cancelled_)
+        {
+            throw RenderCancelled("render cancelled");
+        }
+        if (cancelled())
+        {
+            throw RenderCancelled("render deadline exceeded");
+        }
+    }
+}
@@ -0,0 +1,70 @@
+//! @file Cancellation.hpp
+#ifndef __svg_Cancellation_hpp__
+#define __svg_Cancellation_hpp__
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+namespace svg
+{
+    //! Error thrown when a render is cancelled or runs past its deadline.
+    class RenderCancelled : public std::runtime_error
+    {
+    public:
+        //! Constructor.
+        //! @param what Reason.
+        explicit RenderCancelled(const char *what);
+    };
+
+    //! Cancellation flag and optional deadline, shared between the code
+    //! that requests a render and the render itself. Parsing and drawing
+    //! poll it at coarse intervals (per element, every few dozen rows)
+    //! and throw RenderCancelled once it fires. All member functions are
+    //! thread-safe.
+    class CancellationToken
+    {
+    public:
+        //! Clock used for deadlines.
+        typedef std::chrono::steady_clock Clock;
+
+        //! Constructor of a token without deadline.
+        //! @param parent Token whose cancellation and deadline this token
+        //! also follows (e.g. a whole batch, for the token of one job),
+        //! or nullptr; must outlive this token.
+        explicit CancellationToken(const CancellationToken *parent = nullptr);
+        //! Request cancellation.
+        void cancel();
+        //! Set the deadline.
+        //! @param deadline Time after which the token counts as cancelled.
+        void set_deadline(Clock::time_point deadline);
+        //! Set the deadline relative to now.
+        //! @param timeout Time from now after which the token counts as cancelled.
+        void set_timeout(std::chrono::milliseconds timeout);
+        //! Check if cancellation was requested or the deadline passed.
+        //! @return true if the render should stop.
+        bool cancelled() const;
+        //! Throw if the render should stop.
+        void check() const;
+
+    private:
+        //! Token also followed, or nullptr.
+        const CancellationToken *parent_;
+        //! Whether cancel() was called.
+        std::atomic<bool> cancelled_;
+        //! Deadline, in clock ticks since the epoch (max if none).
+        std::atomic<Clock::rep> deadline_;
+    };
+
+    //! Throw if a token (possibly null) has fired.
+    //! @param token Token, or nullptr for renders that cannot be cancelled.
+    inline void check_cancelled(const CancellationToken *token)
+    {
+        if (token != nullptr)
+        {
+            token->check();
+        }
+    }
+}
+
+#endif
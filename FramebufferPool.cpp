@@ -0,0 +1,110 @@
+//! @file FramebufferPool.cpp
+#include "FramebufferPool.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace svg
+{
+    FramebufferPool::FramebufferPool(size_t max_idle_bytes)
+        : max_idle_bytes_(max_idle_bytes), idle_bytes_(0)
+    {
+    }
+
+    FramebufferPool::~FramebufferPool()
+    {
+    }
+
+    size_t FramebufferPool::bucket(size_t n)
+    {
+        size_t b = 0;
+        while (capacity(b) < n)
+        {
+            b++;
+        }
+        return b;
+    }
+
+    size_t FramebufferPool::capacity(size_t b)
+    {
+        // Steps of 1/8 waste at most 1/8 of a buffer, against up to a half
+        // with powers of two.
+        return (size_t)(8 + (b & 7)) << (b >> 3);
+    }
+
+    PNGImage FramebufferPool::acquire(int w, int h)
+    {
+        assert(w > 0 && h > 0);
+        size_t n = (size_t)w * h, b = bucket(n);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (b < idle_.size() && !idle_[b].empty())
+            {
+                IdleBuffer idle = std::move(idle_[b].back());
+                idle_[b].pop_back();
+                idle_bytes_ -= idle.image.capacity_ * sizeof(Color);
+                lock.unlock();
+                if (idle.white < n)
+                {
+                    ::memset(idle.image.pixels_ + idle.white, 0xFF, (n - idle.white) * sizeof(Color));
+                }
+                idle.image.width_ = w;
+                idle.image.height_ = h;
+                return std::move(idle.image);
+            }
+        }
+        size_t pixel_capacity = capacity(b);
+        Color *pixels = (Color *)::malloc(pixel_capacity * sizeof(Color));
+        if (pixels == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        ::memset(pixels, 0xFF, n * sizeof(Color));
+        return PNGImage(pixels, pixel_capacity, w, h);
+    }
+
+    void FramebufferPool::release(PNGImage &&img)
+    {
+        PNGImage recycled = std::move(img);
+        size_t b = bucket(recycled.capacity_);
+        if (recycled.pixels_ == nullptr || recycled.storage_ != PixelStorage::Dense ||
+            recycled.capacity_ != capacity(b))
+        {
+            // Not a pool buffer.
+            return;
+        }
+        size_t bytes = recycled.capacity_ * sizeof(Color);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (idle_bytes_ + bytes > max_idle_bytes_)
+            {
+                return;
+            }
+            idle_bytes_ += bytes;
+        }
+        // Clear outside the lock; the buffer is not yet visible to others.
+        // Written pixels all lie within the image, which was white.
+        size_t white = (size_t)recycled.width_ * recycled.height_;
+        recycled.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() <= b)
+        {
+            idle_.resize(b + 1);
+        }
+        idle_[b].push_back({std::move(recycled), white});
+    }
+
+    size_t FramebufferPool::idle_bytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return idle_bytes_;
+    }
+
+    FramebufferPool &FramebufferPool::shared()
+    {
+        static FramebufferPool pool;
+        return pool;
+    }
+}
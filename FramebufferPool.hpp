@@ -0,0 +1,76 @@
+//! @file FramebufferPool.hpp
+#ifndef __svg_FramebufferPool_hpp__
+#define __svg_FramebufferPool_hpp__
+
+#include "PNGImage.hpp"
+
+#include <mutex>
+#include <vector>
+
+namespace svg
+{
+    //! Pool of pixel buffers for blank images, so that repeated
+    //! renders of similar canvases reuse memory instead of allocating
+    //! and clearing a new buffer each time. Buffers are grouped by
+    //! capacity, in steps of an eighth of a power of two pixels. Only
+    //! the pixels of the image are cleared when a buffer is handed out,
+    //! and a returned buffer is made white again by clearing only the
+    //! pixels that were written. All member functions are thread-safe.
+    class FramebufferPool
+    {
+    public:
+        //! Constructor.
+        //! @param max_idle_bytes Limit on the memory held by idle buffers.
+        explicit FramebufferPool(size_t max_idle_bytes = 256u << 20);
+        //! Destructor; frees the idle buffers.
+        ~FramebufferPool();
+        FramebufferPool(const FramebufferPool &) = delete;
+        FramebufferPool &operator=(const FramebufferPool &) = delete;
+
+        //! Get a blank image, reusing an idle buffer when one is large enough.
+        //! @param w Image width.
+        //! @param h Image height.
+        //! @return White image of size w x h, with origin (0, 0).
+        PNGImage acquire(int w, int h);
+        //! Return an image's buffer to the pool. The buffer is dropped
+        //! if the idle limit would be exceeded.
+        //! @param img Image to recycle; left empty.
+        void release(PNGImage &&img);
+        //! Get the memory held by idle buffers.
+        //! @return Size in bytes.
+        size_t idle_bytes() const;
+        //! Pool shared by the conversion functions.
+        //! @return The shared pool.
+        static FramebufferPool &shared();
+
+    private:
+        //! Get the bucket of the smallest buffers with at least n pixels.
+        //! @param n Number of pixels.
+        //! @return Bucket index.
+        static size_t bucket(size_t n);
+        //! Get the capacity of the buffers of a bucket.
+        //! @param b Bucket index.
+        //! @return (8 + b % 8) * 2^(b / 8) pixels.
+        static size_t capacity(size_t b);
+
+        //! Idle buffer.
+        struct IdleBuffer
+        {
+            //! Image owning the buffer.
+            PNGImage image;
+            //! Pixels [0, white) are white; the rest are undefined.
+            size_t white;
+        };
+
+        //! Limit on idle memory.
+        size_t max_idle_bytes_;
+        //! Idle memory.
+        size_t idle_bytes_;
+        //! Idle buffers, by bucket.
+        std::vector<std::vector<IdleBuffer>> idle_;
+        //! Protects the members above.
+        mutable std::mutex mutex_;
+    };
+}
+
+#endif
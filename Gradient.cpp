@@ -0,0 +1,280 @@
+//! @file Gradient.cpp
+#include "Gradient.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace svg
+{
+    // Positions are clamped to this range before conversion to table
+    // indices, so the conversions cannot overflow.
+    static const float T_LIMIT = 1e6f;
+
+    Gradient::Gradient()
+        : radial(false), user_space(false), spread(GradientSpread::Pad),
+          x1(0), y1(0), x2(1), y2(0), cx(0.5), cy(0.5), r(0.5), fx(0.5), fy(0.5)
+    {
+    }
+
+    // Position within [0, 1] of a gradient position; the vector paths
+    // below perform the same float operations.
+    static float spread_position(float t, GradientSpread spread)
+    {
+        // NaN goes to -T_LIMIT, as with _mm_max_ps.
+        t = t > -T_LIMIT ? std::min(t, T_LIMIT) : -T_LIMIT;
+        switch (spread)
+        {
+        case GradientSpread::Repeat:
+            return t - std::floor(t);
+        case GradientSpread::Reflect:
+        {
+            float m = t * 0.5f;
+            return 1.0f - std::fabs((m - std::floor(m)) * 2.0f - 1.0f);
+        }
+        default:
+            return std::min(std::max(t, 0.0f), 1.0f);
+        }
+    }
+
+    GradientShader::GradientShader(const Gradient &gradient, const BoundingBox &box,
+                                   const BoundingBox &reference)
+        : radial_(gradient.radial), spread_(gradient.spread)
+    {
+        // Color table.
+        const std::vector<GradientStop> &stops = gradient.stops;
+        size_t k = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            double t = i / 255.0;
+            while (k < stops.size() && stops[k].offset <= t)
+            {
+                k++;
+            }
+            if (k == 0 || k == stops.size())
+            {
+                lut_[i] = stops[k == 0 ? 0 : k - 1].color;
+                continue;
+            }
+            const GradientStop &a = stops[k - 1], &b = stops[k];
+            double f = (t - a.offset) / (b.offset - a.offset);
+            lut_[i].red = (rgb_value)::lround(a.color.red + f * (b.color.red - a.color.red));
+            lut_[i].green = (rgb_value)::lround(a.color.green + f * (b.color.green - a.color.green));
+            lut_[i].blue = (rgb_value)::lround(a.color.blue + f * (b.color.blue - a.color.blue));
+        }
+
+        // Pixel to gradient space.
+        double bw = std::max(1, box.max.x - box.min.x), bh = std::max(1, box.max.y - box.min.y);
+        double su = 1 / bw, sv = 1 / bh, u0 = 0, v0 = 0;
+        if (gradient.user_space)
+        {
+            su *= std::max(1, reference.max.x - reference.min.x);
+            sv *= std::max(1, reference.max.y - reference.min.y);
+            u0 = reference.min.x;
+            v0 = reference.min.y;
+        }
+        u0_ = (float)(u0 - box.min.x * su);
+        v0_ = (float)(v0 - box.min.y * sv);
+        su_ = (float)su;
+        sv_ = (float)sv;
+
+        // Degenerate gradients paint the last stop color.
+        tu_ = tv_ = 0;
+        t0_ = 1;
+        fx_ = fy_ = cdx_ = cdy_ = a_ = 0;
+        if (!radial_)
+        {
+            double dx = gradient.x2 - gradient.x1, dy = gradient.y2 - gradient.y1;
+            double len2 = dx * dx + dy * dy;
+            // Coordinates near the double range overflow len2: degenerate.
+            if (len2 > 0 && std::isfinite(len2))
+            {
+                tu_ = (float)(dx / len2);
+                tv_ = (float)(dy / len2);
+                t0_ = (float)(-(gradient.x1 * dx + gradient.y1 * dy) / len2);
+            }
+        }
+        else if (gradient.r > 0 && std::isfinite(gradient.r * gradient.r))
+        {
+            // Keep the focal point inside the end circle.
+            double fx = gradient.fx, fy = gradient.fy;
+            double cdx = gradient.cx - fx, cdy = gradient.cy - fy;
+            double d = ::hypot(cdx, cdy), limit = 0.99 * gradient.r;
+            if (d > limit)
+            {
+                cdx *= limit / d;
+                cdy *= limit / d;
+                fx = gradient.cx - cdx;
+                fy = gradient.cy - cdy;
+            }
+            fx_ = (float)fx;
+            fy_ = (float)fy;
+            cdx_ = (float)cdx;
+            cdy_ = (float)cdy;
+            a_ = (float)(cdx * cdx + cdy * cdy - gradient.r * gradient.r);
+        }
+        else
+        {
+            radial_ = false;
+        }
+    }
+
+    void GradientShader::shade(int x, int y, int n, Color *out) const
+    {
+        // Radial: with d = p - focal, the position t puts p on the circle
+        // of center focal + t * cd and radius t * r, i.e. the root of
+        // a t^2 - 2 b t + |d|^2 = 0 with b = d . cd.
+        // Chunks are aligned to absolute x and each pixel steps from the
+        // start of its chunk, so a pixel does not depend on the span that
+        // covers it (regions and clipped spans match the full image).
+        const int CHUNK = 64;
+        float t[CHUNK];
+        float dv = v0_ + y * sv_ - fy_;
+        float lin = tv_ * (v0_ + y * sv_) + t0_;
+        while (n > 0)
+        {
+            int k = (x % CHUNK + CHUNK) % CHUNK;
+            int m = std::min(n, CHUNK - k);
+            float u = (float)((double)u0_ + (double)(x - k) * su_);
+            int i = 0;
+            if (!radial_)
+            {
+                float base = lin + tu_ * u, step = tu_ * su_;
+#if defined(__SSE2__)
+                const __m128 vb = _mm_set1_ps(base), vs = _mm_set1_ps(step);
+                for (; i + 4 <= m; i += 4)
+                {
+                    __m128 idx = _mm_cvtepi32_ps(_mm_setr_epi32(k + i, k + i + 1, k + i + 2, k + i + 3));
+                    _mm_storeu_ps(t + i, _mm_add_ps(vb, _mm_mul_ps(idx, vs)));
+                }
+#elif defined(__aarch64__)
+                const float32x4_t vb = vdupq_n_f32(base);
+                for (; i + 4 <= m; i += 4)
+                {
+                    const float lane[4] = {(float)(k + i), (float)(k + i + 1), (float)(k + i + 2), (float)(k + i + 3)};
+                    vst1q_f32(t + i, vmlaq_n_f32(vb, vld1q_f32(lane), step));
+                }
+#endif
+                for (; i < m; i++)
+                {
+                    t[i] = base + (float)(k + i) * step;
+                }
+            }
+            else
+            {
+                float du0 = u - fx_, inv_a = 1.0f / a_;
+                float bv = dv * cdy_, dv2 = dv * dv;
+#if defined(__SSE2__)
+                const __m128 vdu0 = _mm_set1_ps(du0), vsu = _mm_set1_ps(su_);
+                const __m128 vcdx = _mm_set1_ps(cdx_), vbv = _mm_set1_ps(bv), vdv2 = _mm_set1_ps(dv2);
+                const __m128 va = _mm_set1_ps(a_), vinv = _mm_set1_ps(inv_a), zero = _mm_setzero_ps();
+                for (; i + 4 <= m; i += 4)
+                {
+                    __m128 idx = _mm_cvtepi32_ps(_mm_setr_epi32(k + i, k + i + 1, k + i + 2, k + i + 3));
+                    __m128 du = _mm_add_ps(vdu0, _mm_mul_ps(idx, vsu));
+                    __m128 b = _mm_add_ps(_mm_mul_ps(du, vcdx), vbv);
+                    __m128 dd = _mm_add_ps(_mm_mul_ps(du, du), vdv2);
+                    __m128 disc = _mm_max_ps(_mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(va, dd)), zero);
+                    _mm_storeu_ps(t + i, _mm_mul_ps(_mm_sub_ps(b, _mm_sqrt_ps(disc)), vinv));
+                }
+#elif defined(__aarch64__)
+                const float32x4_t vdu0 = vdupq_n_f32(du0), vbv = vdupq_n_f32(bv), vdv2 = vdupq_n_f32(dv2);
+                const float32x4_t zero = vdupq_n_f32(0);
+                for (; i + 4 <= m; i += 4)
+                {
+                    const float lane[4] = {(float)(k + i), (float)(k + i + 1), (float)(k + i + 2), (float)(k + i + 3)};
+                    float32x4_t du = vaddq_f32(vdu0, vmulq_n_f32(vld1q_f32(lane), su_));
+                    float32x4_t b = vaddq_f32(vmulq_n_f32(du, cdx_), vbv);
+                    float32x4_t dd = vaddq_f32(vmulq_f32(du, du), vdv2);
+                    float32x4_t disc = vmaxq_f32(vsubq_f32(vmulq_f32(b, b), vmulq_n_f32(dd, a_)), zero);
+                    vst1q_f32(t + i, vmulq_n_f32(vsubq_f32(b, vsqrtq_f32(disc)), inv_a));
+                }
+#endif
+                for (; i < m; i++)
+                {
+                    float du = du0 + (float)(k + i) * su_;
+                    float b = du * cdx_ + bv;
+                    float dd = du * du + dv2;
+                    float disc = std::max(b * b - a_ * dd, 0.0f);
+                    t[i] = (b - std::sqrt(disc)) * inv_a;
+                }
+            }
+            lookup(t, m, out);
+            x += m;
+            out += m;
+            n -= m;
+        }
+    }
+
+    void GradientShader::lookup(float *t, int n, Color *out) const
+    {
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 lo = _mm_set1_ps(-T_LIMIT), hi = _mm_set1_ps(T_LIMIT);
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1), half = _mm_set1_ps(0.5f);
+        const __m128 two = _mm_set1_ps(2), scale = _mm_set1_ps(255);
+        const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        int idx[4];
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(t + i), lo), hi);
+            if (spread_ == GradientSpread::Pad)
+            {
+                v = _mm_min_ps(_mm_max_ps(v, zero), one);
+            }
+            else
+            {
+                __m128 m = spread_ == GradientSpread::Reflect ? _mm_mul_ps(v, half) : v;
+                // floor: truncate, then step down where truncation rounded up.
+                __m128 f = _mm_cvtepi32_ps(_mm_cvttps_epi32(m));
+                f = _mm_sub_ps(f, _mm_and_ps(_mm_cmpgt_ps(f, m), one));
+                v = _mm_sub_ps(m, f);
+                if (spread_ == GradientSpread::Reflect)
+                {
+                    v = _mm_sub_ps(one, _mm_and_ps(_mm_sub_ps(_mm_mul_ps(v, two), one), abs_mask));
+                }
+            }
+            _mm_storeu_si128((__m128i *)idx, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half)));
+            out[i] = lut_[idx[0]];
+            out[i + 1] = lut_[idx[1]];
+            out[i + 2] = lut_[idx[2]];
+            out[i + 3] = lut_[idx[3]];
+        }
+#elif defined(__aarch64__)
+        const float32x4_t lo = vdupq_n_f32(-T_LIMIT), hi = vdupq_n_f32(T_LIMIT);
+        const float32x4_t zero = vdupq_n_f32(0), one = vdupq_n_f32(1);
+        int32_t idx[4];
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t v = vminq_f32(vmaxq_f32(vld1q_f32(t + i), lo), hi);
+            if (spread_ == GradientSpread::Pad)
+            {
+                v = vminq_f32(vmaxq_f32(v, zero), one);
+            }
+            else
+            {
+                float32x4_t m = spread_ == GradientSpread::Reflect ? vmulq_n_f32(v, 0.5f) : v;
+                v = vsubq_f32(m, vrndmq_f32(m));
+                if (spread_ == GradientSpread::Reflect)
+                {
+                    v = vsubq_f32(one, vabsq_f32(vsubq_f32(vmulq_n_f32(v, 2), one)));
+                }
+            }
+            vst1q_s32(idx, vcvtq_s32_f32(vaddq_f32(vmulq_n_f32(v, 255), vdupq_n_f32(0.5f))));
+            out[i] = lut_[idx[0]];
+            out[i + 1] = lut_[idx[1]];
+            out[i + 2] = lut_[idx[2]];
+            out[i + 3] = lut_[idx[3]];
+        }
+#endif
+        for (; i < n; i++)
+        {
+            out[i] = lut_[(int)(spread_position(t[i], spread_) * 255.0f + 0.5f)];
+        }
+    }
+}
@@ -0,0 +1,94 @@
+//! @file Gradient.hpp
+#ifndef __svg_Gradient_hpp__
+#define __svg_Gradient_hpp__
+
+#include "PNGImage.hpp"
+
+#include <vector>
+
+namespace svg
+{
+    //! Color at a position along a gradient.
+    struct GradientStop
+    {
+        //! Position, from 0 (start) to 1 (end).
+        double offset;
+        //! Color.
+        Color color;
+    };
+
+    //! How a gradient continues beyond its end.
+    enum class GradientSpread
+    {
+        //! Extend the end colors.
+        Pad,
+        //! Mirror the gradient.
+        Reflect,
+        //! Repeat the gradient.
+        Repeat
+    };
+
+    //! Linear or radial gradient, as defined by <linearGradient> or
+    //! <radialGradient>.
+    struct Gradient
+    {
+        //! Constructor of a linear gradient with the SVG defaults.
+        Gradient();
+        //! Radial (true) or linear gradient.
+        bool radial;
+        //! Coordinates are in user space (gradientUnits="userSpaceOnUse")
+        //! rather than fractions of the painted element's bounding box.
+        bool user_space;
+        //! Spread method.
+        GradientSpread spread;
+        //! Linear gradient vector, from (x1, y1) to (x2, y2).
+        double x1, y1, x2, y2;
+        //! Radial gradient end circle, centered at (cx, cy) with radius r.
+        double cx, cy, r;
+        //! Radial gradient focal point.
+        double fx, fy;
+        //! Stops, with non-decreasing offsets.
+        std::vector<GradientStop> stops;
+    };
+
+    //! Shader painting a gradient. Colors come from a 256-entry table;
+    //! the gradient position is stepped along each row and evaluated
+    //! four pixels at a time (SSE2 or NEON where available).
+    class GradientShader : public SpanShader
+    {
+    public:
+        //! Constructor.
+        //! @param gradient Gradient (must have at least one stop).
+        //! @param box Current bounding box of the painted element.
+        //! @param reference Bounding box of the element when the
+        //!        gradient was attached; user-space gradients are
+        //!        evaluated at the position mapping to this box, so they
+        //!        follow later translations and scalings of the element.
+        GradientShader(const Gradient &gradient, const BoundingBox &box,
+                       const BoundingBox &reference);
+        void shade(int x, int y, int n, Color *out) const override;
+
+    private:
+        //! Apply the spread method and look up the colors of positions.
+        //! @param t Gradient positions.
+        //! @param n Number of positions.
+        //! @param out Output colors.
+        void lookup(float *t, int n, Color *out) const;
+
+        //! Colors at positions i / 255.
+        Color lut_[256];
+        //! Radial (true) or linear gradient.
+        bool radial_;
+        //! Spread method.
+        GradientSpread spread_;
+        //! Gradient space position of pixel (x, y) is
+        //! (u0_ + x * su_, v0_ + y * sv_).
+        float u0_, su_, v0_, sv_;
+        //! Linear: position t = tu_ * u + tv_ * v + t0_.
+        float tu_, tv_, t0_;
+        //! Radial: focal point, center minus focal point, and
+        //! |center - focal|^2 - r^2 (negative).
+        float fx_, fy_, cdx_, cdy_, a_;
+    };
+}
+#endif
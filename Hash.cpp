@@ -0,0 +1,99 @@
+//! @file Hash.cpp
+#include "Hash.hpp"
+
+#include <cstring>
+
+namespace svg
+{
+    static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t rotl(uint64_t v, int r)
+    {
+        return (v << r) | (v >> (64 - r));
+    }
+
+    //! Read 8 bytes, little endian.
+    static uint64_t read64(const unsigned char *p)
+    {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; i--)
+        {
+            v = (v << 8) | p[i];
+        }
+        return v;
+    }
+
+    //! Read 4 bytes, little endian.
+    static uint64_t read32(const unsigned char *p)
+    {
+        return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t input)
+    {
+        acc += input * PRIME2;
+        return rotl(acc, 31) * PRIME1;
+    }
+
+    static uint64_t merge_round(uint64_t acc, uint64_t v)
+    {
+        acc ^= round(0, v);
+        return acc * PRIME1 + PRIME4;
+    }
+
+    uint64_t hash64(const void *data, size_t size, uint64_t seed)
+    {
+        const unsigned char *p = (const unsigned char *)data;
+        const unsigned char *end = p + size;
+        uint64_t h;
+        if (size >= 32)
+        {
+            // Four independent lanes over 32-byte stripes.
+            uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2;
+            uint64_t v3 = seed, v4 = seed - PRIME1;
+            for (; p + 32 <= end; p += 32)
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+            }
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge_round(h, v1);
+            h = merge_round(h, v2);
+            h = merge_round(h, v3);
+            h = merge_round(h, v4);
+        }
+        else
+        {
+            h = seed + PRIME5;
+        }
+        h += size;
+        for (; p + 8 <= end; p += 8)
+        {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * PRIME1 + PRIME4;
+        }
+        if (p + 4 <= end)
+        {
+            h ^= read32(p) * PRIME1;
+            h = rotl(h, 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        for (; p < end; p++)
+        {
+            h ^= *p * PRIME5;
+            h = rotl(h, 11) * PRIME1;
+        }
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+}
@@ -0,0 +1,19 @@
+//! @file Hash.hpp
+#ifndef __svg_Hash_hpp__
+#define __svg_Hash_hpp__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace svg
+{
+    //! 64-bit non-cryptographic hash of a byte sequence (the XXH64
+    //! algorithm).
+    //! @param data Bytes to hash.
+    //! @param size Number of bytes.
+    //! @param seed Seed.
+    //! @return Hash value.
+    uint64_t hash64(const void *data, size_t size, uint64_t seed = 0);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "IdTable.hpp"
+#include "Hash.hpp"
+
+using namespace std;
+
+namespace svg
+{
+    const uint32_t IdTable::NONE = UINT32_MAX;
+
+    IdTable::IdTable() : slots(16, NONE) {}
+
+    size_t IdTable::probe(const string& id, uint64_t hash) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            uint32_t symbol = slots[i];
+            if (symbol == NONE || (hashes[symbol] == hash && names[symbol] == id)) {
+                return i;
+            }
+        }
+    }
+
+    uint32_t IdTable::intern(const string& id) {
+        uint64_t hash = hash64(id.data(), id.size());
+        size_t slot = probe(id, hash);
+        if (slots[slot] != NONE) {
+            return slots[slot];
+        }
+        uint32_t symbol = (uint32_t) names.size();
+        names.push_back(id);
+        hashes.push_back(hash);
+        if (2 * names.size() > slots.size()) {
+            // Grow and rehash, keeping the table at most half full.
+            slots.assign(slots.size() * 2, NONE);
+            size_t mask = slots.size() - 1;
+            for (uint32_t s = 0; s < names.size(); s++) {
+                size_t i = hashes[s] & mask;
+                while (slots[i] != NONE) {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = s;
+            }
+        } else {
+            slots[slot] = symbol;
+        }
+        return symbol;
+    }
+
+    uint32_t IdTable::find(const string& id) const {
+        return slots[probe(id, hash64(id.data(), id.size()))];
+    }
+
+    const string& IdTable::name(uint32_t symbol) const {
+        return names[symbol];
+    }
+
+    size_t IdTable::size() const {
+        return names.size();
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef __svg_IdTable_hpp__
+#define __svg_IdTable_hpp__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    /**
+     * @brief Interned element ids: each distinct id string maps to a small integer symbol.
+     *
+     * Open-addressing hash table (linear probing, at most half full) over the
+     * 64-bit hash of each id; a lookup hashes the key once and compares strings
+     * only on a full hash match.
+     */
+    class IdTable
+    {
+    public:
+        static const uint32_t NONE; ///< The symbol returned for unknown ids.
+
+        IdTable(); ///< Constructor of empty table.
+        /**
+         * @brief Gets the symbol of an id, adding it if new.
+         * @param id The id.
+         * @return The symbol; symbols are numbered 0, 1, ... in order of first intern().
+         */
+        uint32_t intern(const std::string &id);
+        /**
+         * @brief Gets the symbol of an id.
+         * @param id The id.
+         * @return The symbol, or NONE if the id was never interned.
+         */
+        uint32_t find(const std::string &id) const;
+        /**
+         * @brief Gets the id of a symbol.
+         * @param symbol The symbol.
+         * @return The id.
+         */
+        const std::string &name(uint32_t symbol) const;
+        /**
+         * @brief Gets the number of interned ids.
+         * @return The number of ids.
+         */
+        size_t size() const;
+
+    private:
+        /**
+         * @brief Finds the slot holding an id, or the empty slot where it would go.
+         * @param id The id.
+         * @param hash The hash of the id.
+         * @return The slot index.
+         */
+        size_t probe(const std::string &id, uint64_t hash) const;
+
+        std::vector<std::string> names; ///< The ids, by symbol.
+        std::vector<uint64_t> hashes; ///< The hash of each id, by symbol.
+        std::vector<uint32_t> slots; ///< The hash table of symbols (NONE for empty slots).
+    };
+}
+
+#endif
@@ -0,0 +1,217 @@
+//! @file ImageDiff.cpp
+#include "ImageDiff.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace svg
+{
+    DiffOptions::DiffOptions()
+        : tolerance(0)
+    {
+    }
+
+    bool DiffResult::match() const
+    {
+        return same_size && mismatches == 0;
+    }
+
+    //! Statistics of a row (or part of it).
+    struct RowStats
+    {
+        uint64_t sum_squares;
+        int max_delta;
+        size_t mismatches;
+        int first_mismatch;
+    };
+
+    //! Scalar kernel over pixels [x0, x1) of a row.
+    static void diff_pixels(const rgb_value *a, const rgb_value *b, int x0, int x1,
+                            int tolerance, RowStats &stats)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            int worst = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                int d = std::abs(a[3 * x + k] - b[3 * x + k]);
+                stats.sum_squares += d * d;
+                worst = std::max(worst, d);
+            }
+            stats.max_delta = std::max(stats.max_delta, worst);
+            if (worst > tolerance)
+            {
+                if (stats.mismatches++ == 0)
+                {
+                    stats.first_mismatch = x;
+                }
+            }
+        }
+    }
+
+    //! Vector kernel over a row of w pixels. Blocks of 16 pixels (48
+    //! bytes) are compared as three vectors; only blocks with some
+    //! channel over the tolerance are rescanned to count pixels.
+    static void diff_row(const rgb_value *a, const rgb_value *b, int w, int tolerance,
+                         RowStats &stats)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i tol = _mm_set1_epi8((char)std::min(tolerance, 255));
+        __m128i max_acc = zero, sq_acc = zero;
+        for (; x + 16 <= w; x += 16)
+        {
+            __m128i over = zero, sq = zero;
+            for (int k = 0; k < 3; k++)
+            {
+                __m128i va = _mm_loadu_si128((const __m128i *)(a + 3 * x + 16 * k));
+                __m128i vb = _mm_loadu_si128((const __m128i *)(b + 3 * x + 16 * k));
+                __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+                max_acc = _mm_max_epu8(max_acc, d);
+                over = _mm_or_si128(over, _mm_subs_epu8(d, tol));
+                __m128i lo = _mm_unpacklo_epi8(d, zero), hi = _mm_unpackhi_epi8(d, zero);
+                sq = _mm_add_epi32(sq, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+            }
+            // Each 32-bit lane holds at most 6 * 2 * 255^2; widen to 64 bits.
+            sq_acc = _mm_add_epi64(sq_acc, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(over, zero)) != 0xFFFF)
+            {
+                RowStats block = {0, 0, 0, 0};
+                diff_pixels(a, b, x, x + 16, tolerance, block);
+                if (stats.mismatches == 0)
+                {
+                    stats.first_mismatch = block.first_mismatch;
+                }
+                stats.mismatches += block.mismatches;
+            }
+        }
+        uint8_t max_bytes[16];
+        uint64_t sq_words[2];
+        _mm_storeu_si128((__m128i *)max_bytes, max_acc);
+        _mm_storeu_si128((__m128i *)sq_words, sq_acc);
+        stats.max_delta = std::max(stats.max_delta, (int)*std::max_element(max_bytes, max_bytes + 16));
+        stats.sum_squares += sq_words[0] + sq_words[1];
+#elif defined(__aarch64__)
+        const uint8x16_t tol = vdupq_n_u8((uint8_t)std::min(tolerance, 255));
+        uint8x16_t max_acc = vdupq_n_u8(0);
+        uint64x2_t sq_acc = vdupq_n_u64(0);
+        for (; x + 16 <= w; x += 16)
+        {
+            uint8x16_t over = vdupq_n_u8(0);
+            uint32x4_t sq = vdupq_n_u32(0);
+            for (int k = 0; k < 3; k++)
+            {
+                uint8x16_t d = vabdq_u8(vld1q_u8(a + 3 * x + 16 * k), vld1q_u8(b + 3 * x + 16 * k));
+                max_acc = vmaxq_u8(max_acc, d);
+                over = vorrq_u8(over, vqsubq_u8(d, tol));
+                sq = vpadalq_u16(sq, vmull_u8(vget_low_u8(d), vget_low_u8(d)));
+                sq = vpadalq_u16(sq, vmull_u8(vget_high_u8(d), vget_high_u8(d)));
+            }
+            sq_acc = vpadalq_u32(sq_acc, sq);
+            if (vmaxvq_u8(over) != 0)
+            {
+                RowStats block = {0, 0, 0, 0};
+                diff_pixels(a, b, x, x + 16, tolerance, block);
+                if (stats.mismatches == 0)
+                {
+                    stats.first_mismatch = block.first_mismatch;
+                }
+                stats.mismatches += block.mismatches;
+            }
+        }
+        stats.max_delta = std::max(stats.max_delta, (int)vmaxvq_u8(max_acc));
+        stats.sum_squares += vgetq_lane_u64(sq_acc, 0) + vgetq_lane_u64(sq_acc, 1);
+#endif
+        RowStats tail = {0, 0, 0, 0};
+        diff_pixels(a, b, x, w, tolerance, tail);
+        if (stats.mismatches == 0)
+        {
+            stats.first_mismatch = tail.first_mismatch;
+        }
+        stats.mismatches += tail.mismatches;
+        stats.max_delta = std::max(stats.max_delta, tail.max_delta);
+        stats.sum_squares += tail.sum_squares;
+    }
+
+    //! Write the difference heatmap.
+    static void write_heatmap(const PNGImage &a, const PNGImage &b, int tolerance,
+                              const std::string &file)
+    {
+        PNGImage heatmap(a.width(), a.height());
+        for (int y = 0; y < a.height(); y++)
+        {
+            const Color *ra = a.row(y), *rb = b.row(y);
+            for (int x = 0; x < a.width(); x++)
+            {
+                int d = std::max({std::abs(ra[x].red - rb[x].red),
+                                  std::abs(ra[x].green - rb[x].green),
+                                  std::abs(ra[x].blue - rb[x].blue)});
+                Color &c = heatmap.at(x, y);
+                if (d > tolerance)
+                {
+                    rgb_value shade = (rgb_value)(160 - 160 * d / 255);
+                    c = {255, shade, shade};
+                }
+                else if (d > 0)
+                {
+                    c = {96, 160, 255};
+                }
+                else
+                {
+                    // Faded gray copy of the reference.
+                    int luma = (ra[x].red * 77 + ra[x].green * 150 + ra[x].blue * 29) >> 8;
+                    c.red = c.green = c.blue = (rgb_value)(192 + luma / 4);
+                }
+            }
+        }
+        heatmap.save(file);
+    }
+
+    DiffResult diff(const PNGImage &a, const PNGImage &b, const DiffOptions &options)
+    {
+        DiffResult result;
+        result.same_size = a.width() == b.width() && a.height() == b.height();
+        result.mismatches = 0;
+        result.first_mismatch = {0, 0};
+        result.max_delta = 0;
+        result.psnr = std::numeric_limits<double>::infinity();
+        if (!result.same_size)
+        {
+            return result;
+        }
+        uint64_t sum_squares = 0;
+        for (int y = 0; y < a.height(); y++)
+        {
+            RowStats stats = {0, 0, 0, 0};
+            diff_row((const rgb_value *)a.row(y), (const rgb_value *)b.row(y), a.width(),
+                     options.tolerance, stats);
+            if (result.mismatches == 0 && stats.mismatches > 0)
+            {
+                result.first_mismatch = {stats.first_mismatch, y};
+            }
+            result.mismatches += stats.mismatches;
+            result.max_delta = std::max(result.max_delta, stats.max_delta);
+            sum_squares += stats.sum_squares;
+        }
+        if (sum_squares > 0)
+        {
+            double mse = (double)sum_squares / ((double)a.width() * a.height() * 3);
+            result.psnr = 10 * ::log10(255.0 * 255.0 / mse);
+        }
+        if (!options.heatmap_file.empty())
+        {
+            write_heatmap(a, b, options.tolerance, options.heatmap_file);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,57 @@
+//! @file ImageDiff.hpp
+#ifndef __svg_ImageDiff_hpp__
+#define __svg_ImageDiff_hpp__
+
+#include "PNGImage.hpp"
+
+#include <string>
+
+namespace svg
+{
+    //! Options for diff().
+    struct DiffOptions
+    {
+        //! Constructor of default options (exact comparison, no heatmap).
+        DiffOptions();
+        //! Largest per-channel difference still counted as a match.
+        int tolerance;
+        //! If not empty, a PNG file to write the difference heatmap to:
+        //! matching pixels are shown as a faded copy of the first image,
+        //! pixels within tolerance in blue and mismatches in red (darker
+        //! for larger differences).
+        std::string heatmap_file;
+    };
+
+    //! Result of diff().
+    struct DiffResult
+    {
+        //! Whether both images have the same size; if not, the other
+        //! fields are not computed.
+        bool same_size;
+        //! Number of pixels with some channel differing by more than the
+        //! tolerance.
+        size_t mismatches;
+        //! First mismatching pixel in row order (valid if mismatches > 0).
+        Point first_mismatch;
+        //! Largest per-channel difference over all pixels.
+        int max_delta;
+        //! Peak signal-to-noise ratio in dB, over all channels
+        //! (infinity for identical images).
+        double psnr;
+
+        //! Check if the images match within the tolerance.
+        //! @return true if the sizes are equal and there are no mismatches.
+        bool match() const;
+    };
+
+    //! Compare two images pixel by pixel. The kernel processes 16 pixels
+    //! at a time with SSE2 or NEON where available.
+    //! @param a First image (the reference).
+    //! @param b Second image.
+    //! @param options Comparison options.
+    //! @return Statistics on the differences.
+    DiffResult diff(const PNGImage &a, const PNGImage &b,
+                    const DiffOptions &options = DiffOptions());
+}
+
+#endif
@@ -1,10 +1,22 @@
 #include "PNGImage.hpp"
+#include "Hash.hpp"
+#include "PNGWriter.hpp"
+#include "RunBuffer.hpp"
+#include "TileBuffer.hpp"
 
 #include <stdexcept>
 #include <cmath>
 #include <cstring>
+#include <cstdlib>
 #include <algorithm>
 #include <cassert>
+#include <new>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #define STBI_ONLY_PNG
 #define STB_IMAGE_IMPLEMENTATION
@@ -14,6 +26,8 @@
 
 namespace svg
 {
+    SpanShader::~SpanShader() {}
+
     PNGImage::PNGImage(const std::string &png_file_name)
     {
         int dummy;
@@ -24,24 +38,335 @@ namespace svg
         {
             throw std::runtime_error(png_file_name + ": could not load image!");
         }
+        storage_ = PixelStorage::Dense;
+        origin_ = {0, 0};
+        capacity_ = (size_t)width_ * height_;
+        dirty_begin_ = 0;
+        dirty_end_ = capacity_;
+        block_shift_ = block_mask_ = 0;
+        block_columns_ = 0;
+        cancel_ = nullptr;
+        shader_ = nullptr;
     }
     PNGImage::PNGImage(int w, int h)
     {
         assert(w > 0 && h > 0);
-        size_t sz = w * h * sizeof(Color);
+        size_t sz = (size_t)w * h * sizeof(Color);
         pixels_ = (Color *)::stbi__malloc(sz);
+        if (pixels_ == nullptr)
+        {
+            throw std::bad_alloc();
+        }
         width_ = w;
         height_ = h;
+        storage_ = PixelStorage::Dense;
+        origin_ = {0, 0};
+        capacity_ = (size_t)w * h;
+        dirty_begin_ = dirty_end_ = 0;
+        block_shift_ = block_mask_ = 0;
+        block_columns_ = 0;
+        cancel_ = nullptr;
+        shader_ = nullptr;
         ::memset(pixels_, 0xFF, sz);
     }
+    PNGImage::PNGImage(int w, int h, PixelStorage storage)
+        : width_(w), height_(h), pixels_(nullptr), origin_({0, 0}),
+          capacity_(0), dirty_begin_(0), dirty_end_(0), block_shift_(0),
+          block_mask_(0), block_columns_(0), cancel_(nullptr), shader_(nullptr)
+    {
+        switch (storage)
+        {
+        case PixelStorage::Dense:
+            *this = PNGImage(w, h);
+            break;
+        case PixelStorage::Blocks8:
+        case PixelStorage::Blocks16:
+        {
+            // Whole blocks only, so that offset() needs no edge cases.
+            int shift = storage == PixelStorage::Blocks8 ? 3 : 4;
+            size_t columns = ((size_t)w + (1 << shift) - 1) >> shift;
+            size_t rows = ((size_t)h + (1 << shift) - 1) >> shift;
+            capacity_ = columns * rows << (2 * shift);
+            pixels_ = (Color *)::stbi__malloc(capacity_ * sizeof(Color));
+            if (pixels_ == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            ::memset(pixels_, 0xFF, capacity_ * sizeof(Color));
+            block_shift_ = shift;
+            block_mask_ = (1 << shift) - 1;
+            block_columns_ = columns;
+            break;
+        }
+        case PixelStorage::Runs:
+            store_.reset(new RunBuffer(w, h));
+            break;
+        case PixelStorage::Tiles:
+            store_.reset(new TileBuffer(w, h));
+            break;
+        }
+        storage_ = storage;
+    }
+    PNGImage::PNGImage(Color *pixels, size_t capacity, int w, int h)
+        : width_(w), height_(h), pixels_(pixels), storage_(PixelStorage::Dense), origin_({0, 0}),
+          capacity_(capacity), dirty_begin_(0), dirty_end_(0), block_shift_(0),
+          block_mask_(0), block_columns_(0), cancel_(nullptr), shader_(nullptr)
+    {
+        assert(w > 0 && h > 0 && (size_t)w * h <= capacity);
+    }
+    PNGImage::PNGImage(PNGImage &&other)
+        : width_(other.width_), height_(other.height_), pixels_(other.pixels_),
+          store_(std::move(other.store_)), storage_(other.storage_),
+          origin_(other.origin_), capacity_(other.capacity_),
+          dirty_begin_(other.dirty_begin_), dirty_end_(other.dirty_end_),
+          block_shift_(other.block_shift_), block_mask_(other.block_mask_),
+          block_columns_(other.block_columns_), cancel_(other.cancel_),
+          shader_(other.shader_)
+    {
+        other.width_ = other.height_ = 0;
+        other.pixels_ = nullptr;
+        other.capacity_ = other.dirty_begin_ = other.dirty_end_ = 0;
+    }
+    PNGImage &PNGImage::operator=(PNGImage &&other)
+    {
+        if (this != &other)
+        {
+            stbi_image_free(pixels_);
+            width_ = other.width_;
+            height_ = other.height_;
+            pixels_ = other.pixels_;
+            store_ = std::move(other.store_);
+            storage_ = other.storage_;
+            origin_ = other.origin_;
+            capacity_ = other.capacity_;
+            dirty_begin_ = other.dirty_begin_;
+            dirty_end_ = other.dirty_end_;
+            block_shift_ = other.block_shift_;
+            block_mask_ = other.block_mask_;
+            block_columns_ = other.block_columns_;
+            cancel_ = other.cancel_;
+            shader_ = other.shader_;
+            other.width_ = other.height_ = 0;
+            other.pixels_ = nullptr;
+            other.capacity_ = other.dirty_begin_ = other.dirty_end_ = 0;
+        }
+        return *this;
+    }
+    const Color *PNGImage::row(int y) const
+    {
+        assert(y >= 0 && y < height_);
+        if (store_)
+        {
+            row_buffer_.resize(width_);
+            store_->expand(y, 0, width_, row_buffer_.data());
+            return row_buffer_.data();
+        }
+        if (block_shift_ != 0)
+        {
+            row_buffer_.resize(width_);
+            for (int x = 0; x < width_;)
+            {
+                int end = contiguous_end(x, width_);
+                ::memcpy(row_buffer_.data() + x, pixels_ + offset(x, y), (end - x) * sizeof(Color));
+                x = end;
+            }
+            return row_buffer_.data();
+        }
+        return pixels_ + (size_t)y * width_;
+    }
+    uint64_t PNGImage::hash() const
+    {
+        int32_t dims[] = {width_, height_};
+        size_t n = (size_t)width_ * height_;
+        if (store_ || block_shift_ != 0)
+        {
+            std::vector<Color> pixels(n);
+            for (int y = 0; y < height_; y++)
+            {
+                ::memcpy(pixels.data() + (size_t)y * width_, row(y), width_ * sizeof(Color));
+            }
+            return hash64(pixels.data(), n * sizeof(Color), hash64(dims, sizeof(dims)));
+        }
+        return hash64(pixels_, n * sizeof(Color), hash64(dims, sizeof(dims)));
+    }
     void PNGImage::save(const std::string &png_file_name) const
     {
-        ::stbi_write_png(png_file_name.c_str(),
-                         width_,
-                         height_,
-                         3,
-                         pixels_,
-                         width_ * 3);
+        if (store_ || !stb_can_encode(width_, height_, 3))
+        {
+            PNGStreamWriter writer(png_file_name, width_, height_);
+            std::vector<ColorRun> runs;
+            for (int y = 0; y < height_; y++)
+            {
+                if (store_)
+                {
+                    store_->row_runs(y, runs);
+                    writer.write_row(runs.data(), runs.size());
+                }
+                else
+                {
+                    writer.write_row(row(y));
+                }
+            }
+            if (!writer.finish())
+            {
+                throw std::runtime_error(png_file_name + ": could not save image!");
+            }
+            return;
+        }
+        const Color *pixels = pixels_;
+        std::vector<Color> rows;
+        if (block_shift_ != 0)
+        {
+            // stb encodes row-major pixels only.
+            rows.resize((size_t)width_ * height_);
+            for (int y = 0; y < height_; y++)
+            {
+                ::memcpy(rows.data() + (size_t)y * width_, row(y), width_ * sizeof(Color));
+            }
+            pixels = rows.data();
+        }
+        if (!::stbi_write_png(png_file_name.c_str(),
+                              width_,
+                              height_,
+                              3,
+                              pixels,
+                              width_ * 3))
+        {
+            throw std::runtime_error(png_file_name + ": could not save image!");
+        }
+    }
+
+    bool PNGImage::save_indexed(const std::string &png_file_name,
+                                const std::vector<Color> &colors) const
+    {
+        if (store_)
+        {
+            return save_store_indexed(png_file_name, colors);
+        }
+        Palette palette;
+        for (const Color &c : colors)
+        {
+            palette.add(c);
+        }
+        size_t n = (size_t)width_ * height_;
+        std::vector<uint8_t> indices(n);
+        bool used[Palette::MAX_COLORS] = {};
+        bool fits = n > 0;
+        int index = -1;
+        Color last = {0, 0, 0};
+        for (int y = 0; y < height_ && fits; y++)
+        {
+            const Color *pixels = row(y);
+            uint8_t *row_indices = indices.data() + (size_t)y * width_;
+            for (int x = 0; x < width_; x++)
+            {
+                // Flat-color art comes in runs: look up color changes only.
+                const Color &c = pixels[x];
+                if (index < 0 || c.red != last.red || c.green != last.green || c.blue != last.blue)
+                {
+                    index = palette.add(c);
+                    if (index < 0)
+                    {
+                        fits = false;
+                        break;
+                    }
+                    used[index] = true;
+                    last = c;
+                }
+                row_indices[x] = (uint8_t)index;
+            }
+        }
+        if (!fits)
+        {
+            save(png_file_name);
+            return false;
+        }
+        if (!stb_can_encode(width_, height_, 1))
+        {
+            PNGStreamWriter writer(png_file_name, width_, height_, &palette);
+            for (int y = 0; y < height_; y++)
+            {
+                writer.write_row(row(y));
+            }
+            if (!writer.finish())
+            {
+                save(png_file_name);
+                return false;
+            }
+            return true;
+        }
+
+        // Drop the expected colors no pixel has, which may lower the bit depth.
+        size_t count = palette.colors().size();
+        if (std::count(used, used + count, true) < (std::ptrdiff_t)count)
+        {
+            Palette compact;
+            uint8_t remap[Palette::MAX_COLORS] = {};
+            for (size_t i = 0; i < count; i++)
+            {
+                if (used[i])
+                {
+                    remap[i] = (uint8_t)compact.add(palette.colors()[i]);
+                }
+            }
+            for (uint8_t &i : indices)
+            {
+                i = remap[i];
+            }
+            palette = compact;
+        }
+        if (!write_indexed_png(png_file_name, width_, height_, palette, indices.data()))
+        {
+            save(png_file_name);
+            return false;
+        }
+        return true;
+    }
+
+    bool PNGImage::save_store_indexed(const std::string &png_file_name,
+                                      const std::vector<Color> &colors) const
+    {
+        // Only the colors of runs are looked up; listed colors no run
+        // has are dropped by building the palette from the runs alone,
+        // in the order of the list first.
+        Palette found;
+        std::vector<ColorRun> runs;
+        for (int y = 0; y < height_; y++)
+        {
+            store_->row_runs(y, runs);
+            for (const ColorRun &run : runs)
+            {
+                if (found.add(run.color) < 0)
+                {
+                    save(png_file_name);
+                    return false;
+                }
+            }
+        }
+        Palette palette;
+        for (const Color &c : colors)
+        {
+            if (found.find(c) >= 0)
+            {
+                palette.add(c);
+            }
+        }
+        for (const Color &c : found.colors())
+        {
+            palette.add(c);
+        }
+        PNGStreamWriter writer(png_file_name, width_, height_, &palette);
+        for (int y = 0; y < height_; y++)
+        {
+            store_->row_runs(y, runs);
+            writer.write_row(runs.data(), runs.size());
+        }
+        if (!writer.finish())
+        {
+            save(png_file_name);
+            return false;
+        }
+        return true;
     }
 
     PNGImage::~PNGImage()
@@ -57,19 +382,143 @@ namespace svg
     {
         return height_;
     }
+    PixelStorage PNGImage::storage() const
+    {
+        return storage_;
+    }
+    Point PNGImage::origin() const
+    {
+        return origin_;
+    }
+    void PNGImage::set_origin(const Point &o)
+    {
+        origin_ = o;
+    }
+    void PNGImage::clear()
+    {
+        if (store_)
+        {
+            store_->clear();
+        }
+        if (dirty_begin_ < dirty_end_)
+        {
+            ::memset(pixels_ + dirty_begin_, 0xFF, (dirty_end_ - dirty_begin_) * sizeof(Color));
+        }
+        dirty_begin_ = dirty_end_ = 0;
+        origin_ = {0, 0};
+        cancel_ = nullptr;
+        shader_ = nullptr;
+    }
+    void PNGImage::set_cancellation(const CancellationToken *token)
+    {
+        cancel_ = token;
+    }
+    void PNGImage::set_shader(const SpanShader *shader)
+    {
+        shader_ = shader;
+    }
+    void PNGImage::touch(size_t begin, size_t end)
+    {
+        if (dirty_begin_ == dirty_end_)
+        {
+            dirty_begin_ = begin;
+            dirty_end_ = end;
+            return;
+        }
+        dirty_begin_ = std::min(dirty_begin_, begin);
+        dirty_end_ = std::max(dirty_end_, end);
+    }
+    void PNGImage::plot(int x, int y, const Color &c)
+    {
+        x -= origin_.x;
+        y -= origin_.y;
+        if (x >= 0 && x < width_ && y >= 0 && y < height_)
+        {
+            if (store_)
+            {
+                Color shaded = c;
+                if (shader_)
+                {
+                    shader_->shade(x + origin_.x, y + origin_.y, 1, &shaded);
+                }
+                store_->fill(y, x, x, shaded);
+                return;
+            }
+            size_t i = offset(x, y);
+            touch(i, i + 1);
+            if (shader_)
+            {
+                shader_->shade(x + origin_.x, y + origin_.y, 1, pixels_ + i);
+                return;
+            }
+            pixels_[i] = c;
+        }
+    }
     Color &PNGImage::at(int x, int y)
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        if (store_)
+        {
+            Color *p = store_->address(x, y);
+            assert(p != nullptr);
+            return *p;
+        }
+        size_t i = offset(x, y);
+        touch(i, i + 1);
+        return pixels_[i];
     }
     Color PNGImage::at(int x, int y) const
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        if (store_)
+        {
+            return store_->get(x, y);
+        }
+        return pixels_[offset(x, y)];
     }
     void PNGImage::draw_line(const Point &a, const Point &b, const Color &c)
+    {
+        draw_segment(a, b, c, false);
+    }
+
+    void PNGImage::draw_polyline(const std::vector<Point> &points, const Color &c,
+                                 const StrokeStyle &style)
+    {
+        if (points.size() < 2 || style.width <= 0)
+        {
+            return;
+        }
+        if (style.thin())
+        {
+            // Each segment starts on the last pixel of the previous one.
+            for (size_t i = 0; i + 1 < points.size(); i++)
+            {
+                draw_segment(points[i], points[i + 1], c, i > 0);
+            }
+            return;
+        }
+        StrokeOutline outline(points, style);
+        BoundingBox box = outline.bounds();
+        int y_min = std::max(box.min.y, origin_.y);
+        int y_max = std::min(box.max.y, origin_.y + height_ - 1);
+        std::vector<Point> spans;
+        for (int y = y_min; y <= y_max; y++)
+        {
+            if ((y & 63) == 0)
+            {
+                check_cancelled(cancel_);
+            }
+            outline.row_spans(y, spans);
+            for (const Point &span : spans)
+            {
+                fill_span(span.x, span.y, y, c);
+            }
+        }
+    }
+
+    void PNGImage::draw_segment(const Point &a, const Point &b, const Color &c, bool skip_first)
     {
         //  Bresenham Algorithm.
         int x_from = a.x;
@@ -91,12 +540,19 @@ namespace svg
         }
         dy *= 2;
         dx *= 2;
-        at(x_from, y_from) = c;
+        if (!skip_first)
+        {
+            plot(x_from, y_from, c);
+        }
         if (dx > dy)
         {
             int fraction = dy - (dx / 2);
             while (x_from != x_to)
             {
+                if ((x_from & 4095) == 0)
+                {
+                    check_cancelled(cancel_);
+                }
                 if (fraction >= 0)
                 {
                     y_from += step_y;
@@ -104,7 +560,7 @@ namespace svg
                 }
                 x_from += step_x;
                 fraction += dy;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, c);
             }
         }
         else
@@ -112,6 +568,10 @@ namespace svg
             int fraction = dx - (dy >> 1);
             while (y_from != y_to)
             {
+                if ((y_from & 4095) == 0)
+                {
+                    check_cancelled(cancel_);
+                }
                 if (fraction >= 0)
                 {
                     x_from += step_x;
@@ -119,56 +579,103 @@ namespace svg
                 }
                 y_from += step_y;
                 fraction += dx;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, c);
+            }
+        }
+    }
+
+    bool PNGImage::line_hits(const Point &a, const Point &b, const BoundingBox &region)
+    {
+        // Closed form of draw_line(): along the major axis, step k of
+        // n = |d_major| moves the minor coordinate by
+        // floor((2 * k * |d_minor| + n) / (2 * n)), which is monotone in k.
+        bool x_major = std::abs(b.x - a.x) > std::abs(b.y - a.y);
+        int from = x_major ? a.x : a.y, to = x_major ? b.x : b.y;
+        int minor_from = x_major ? a.y : a.x, minor_to = x_major ? b.y : b.x;
+        int lo = x_major ? region.min.x : region.min.y, hi = x_major ? region.max.x : region.max.y;
+        int minor_lo = x_major ? region.min.y : region.min.x, minor_hi = x_major ? region.max.y : region.max.x;
+        long long n = std::abs(to - from), m = std::abs(minor_to - minor_from);
+        int step = to < from ? -1 : 1, minor_step = minor_to < minor_from ? -1 : 1;
+        long long k0 = step > 0 ? (long long)lo - from : (long long)from - hi;
+        long long k1 = step > 0 ? (long long)hi - from : (long long)from - lo;
+        k0 = std::max(k0, 0LL);
+        k1 = std::min(k1, n);
+        if (k0 > k1)
+        {
+            return false;
+        }
+        long long m0 = n == 0 ? 0 : (2 * k0 * m + n) / (2 * n);
+        long long m1 = n == 0 ? 0 : (2 * k1 * m + n) / (2 * n);
+        long long y0 = minor_from + minor_step * m0, y1 = minor_from + minor_step * m1;
+        return std::min(y0, y1) <= minor_hi && std::max(y0, y1) >= minor_lo;
+    }
+
+    void PNGImage::polygon_spans(const std::vector<Point> &points, int y,
+                                 std::vector<double> &seg, std::vector<Point> &spans)
+    {
+        seg.clear();
+        spans.clear();
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            Point a = points[i];
+            Point b = points[(i + 1) % points.size()];
+            if (y < std::min(a.y, b.y) || y > std::max(a.y, b.y))
+            {
+                continue;
+            }
+            if (a.y != b.y)
+            {
+                double x_inters = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
+                seg.push_back(x_inters);
+            }
+        }
+        std::sort(seg.begin(), seg.end());
+        size_t i_s = 0;
+        while ((i_s + 1) < seg.size())
+        {
+            int a = (int)round(seg.at(i_s));
+            int b = (int)round(seg.at(i_s + 1));
+            if (a == b)
+            {
+                i_s++;
+            }
+            else
+            {
+                spans.push_back({a, b});
+                i_s += 2;
             }
         }
     }
 
     void PNGImage::draw_polygon(const std::vector<Point> &points, const Color &c)
     {
-        int x_min = width(), x_max = 0, y_min = height(), y_max = 0;
+        if (points.empty())
+        {
+            return;
+        }
+        int y_min = points[0].y, y_max = points[0].y;
         for (const Point &p : points)
         {
-            x_min = std::min(x_min, p.x);
-            x_max = std::max(x_max, p.x);
             y_min = std::min(y_min, p.y);
             y_max = std::max(y_max, p.y);
         }
+        // Rows outside the image produce no visible fill.
+        y_min = std::max(y_min, origin_.y);
+        y_max = std::min(y_max, origin_.y + height_);
 
         std::vector<double> seg;
+        std::vector<Point> spans;
         for (int y = y_min; y < y_max; y++)
         {
-            for (size_t i = 0; i < points.size(); i++)
+            if ((y & 63) == 0)
             {
-                Point a = points[i];
-                Point b = points[(i + 1) % points.size()];
-                if (y < std::min(a.y, b.y) || y > std::max(a.y, b.y))
-                {
-                    continue;
-                }
-                if (a.y != b.y)
-                {
-                    double x_inters = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
-                    seg.push_back(x_inters);
-                }
+                check_cancelled(cancel_);
             }
-            std::sort(seg.begin(), seg.end());
-            size_t i_s = 0;
-            while ((i_s + 1) < seg.size())
+            polygon_spans(points, y, seg, spans);
+            for (const Point &span : spans)
             {
-                Point a = {(int)round(seg.at(i_s)), y};
-                Point b = {(int)round(seg.at(i_s + 1)), y};
-                if (a.x == b.x)
-                {
-                    i_s++;
-                }
-                else
-                {
-                    draw_line(a, b, c);
-                    i_s += 2;
-                }
+                fill_span(span.x, span.y, y, c);
             }
-            seg.clear();
         }
         for (size_t i = 0; i < points.size(); i++)
         {
@@ -176,36 +683,257 @@ namespace svg
         }
     }
 
-    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill)
+    void PNGImage::fill_contours(const std::vector<Contour> &contours, FillRule rule, const Color &c)
     {
-        draw_line(center.translate({-radius.x, 0}),
-                  center.translate({+radius.x, 0}),
-                  fill);
-        int x0 = radius.x;
-        int dx = 0;
-        for (int y = 1; y <= radius.y; y++)
+        ContourFill area(contours, rule);
+        BoundingBox box = area.bounds();
+        // Rows outside the image produce no visible fill.
+        int y_min = std::max(box.min.y, origin_.y);
+        int y_max = std::min(box.max.y, origin_.y + height_ - 1);
+
+        std::vector<Point> spans;
+        for (int y = y_min; y <= y_max; y++)
         {
-            double vy = (double)y / (double)radius.y;
-            vy *= vy;
-            int x1 = x0 - (dx - 1);
-            for (; x1 > 0; x1--)
+            if ((y & 63) == 0)
             {
-                double vx = (double)x1 / (double)radius.x;
-                vx *= vx;
-                if (vx + vy <= 1)
-                {
-                    break;
-                }
+                check_cancelled(cancel_);
+            }
+            area.row_spans(y, spans);
+            for (const Point &span : spans)
+            {
+                fill_span(span.x, span.y, y, c);
+            }
+        }
+    }
+
+    void PNGImage::fill_span(int x0, int x1, int y, const Color &c)
+    {
+        x0 -= origin_.x;
+        x1 -= origin_.x;
+        y -= origin_.y;
+        if (y < 0 || y >= height_)
+        {
+            return;
+        }
+        if (x0 > x1)
+        {
+            std::swap(x0, x1);
+        }
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, width_ - 1);
+        if (x0 > x1)
+        {
+            return;
+        }
+        if (store_)
+        {
+            if (shader_)
+            {
+                row_buffer_.resize(x1 - x0 + 1);
+                shader_->shade(x0 + origin_.x, y + origin_.y, x1 - x0 + 1, row_buffer_.data());
+                store_->set_pixels(y, x0, x1 - x0 + 1, row_buffer_.data());
+                return;
+            }
+            store_->fill(y, x0, x1, c);
+            return;
+        }
+        // Offsets grow with x along a row, so the ends bound the dirty range.
+        touch(offset(x0, y), offset(x1, y) + 1);
+        for (int x = x0; x <= x1;)
+        {
+            int end = contiguous_end(x, x1 + 1);
+            Color *p = pixels_ + offset(x, y);
+            if (shader_)
+            {
+                shader_->shade(x + origin_.x, y + origin_.y, end - x, p);
+            }
+            else
+            {
+                std::fill(p, p + (end - x), c);
+            }
+            x = end;
+        }
+    }
+
+    std::unique_ptr<PNGImage> PNGImage::begin_layer(const BoundingBox &box) const
+    {
+        BoundingBox image = {origin_, {origin_.x + width_ - 1, origin_.y + height_ - 1}};
+        BoundingBox region = box.intersection(image);
+        if (region.empty())
+        {
+            return nullptr;
+        }
+        int w = region.max.x - region.min.x + 1, h = region.max.y - region.min.y + 1;
+        std::unique_ptr<PNGImage> layer(new PNGImage(w, h));
+        for (int y = 0; y < h; y++)
+        {
+            ::memcpy(layer->pixels_ + (size_t)y * w,
+                     row(region.min.y - origin_.y + y) + (region.min.x - origin_.x),
+                     w * sizeof(Color));
+        }
+        layer->origin_ = region.min;
+        layer->cancel_ = cancel_;
+        return layer;
+    }
+
+    void PNGImage::end_layer(const PNGImage &layer, double opacity)
+    {
+        uint8_t alpha = (uint8_t)::lround(std::max(0.0, std::min(1.0, opacity)) * 255);
+        int x = layer.origin_.x - origin_.x;
+        for (int y = 0; y < layer.height_; y++)
+        {
+            if (store_)
+            {
+                int row_y = layer.origin_.y - origin_.y + y;
+                row_buffer_.resize(layer.width_);
+                store_->expand(row_y, x, layer.width_, row_buffer_.data());
+                blend_pixels(row_buffer_.data(), layer.row(y), layer.width_, alpha);
+                store_->set_pixels(row_y, x, layer.width_, row_buffer_.data());
+                continue;
+            }
+            int row_y = layer.origin_.y - origin_.y + y;
+            const Color *src = layer.row(y);
+            touch(offset(x, row_y), offset(x + layer.width_ - 1, row_y) + 1);
+            for (int sx = x; sx < x + layer.width_;)
+            {
+                int end = contiguous_end(sx, x + layer.width_);
+                blend_pixels(pixels_ + offset(sx, row_y), src + (sx - x), end - sx, alpha);
+                sx = end;
+            }
+        }
+    }
+
+    void PNGImage::blend_pixels(Color *dst, const Color *src, size_t n, uint8_t alpha)
+    {
+        // Colors are packed RGB bytes, so blend byte-wise; all paths use
+        // t = s * a + d * (255 - a) + 128, r = (t + (t >> 8)) >> 8,
+        // which is t / 255 rounded, exactly.
+        uint8_t *d = (uint8_t *)dst;
+        const uint8_t *s = (const uint8_t *)src;
+        size_t bytes = n * sizeof(Color), i = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i a = _mm_set1_epi16(alpha), b = _mm_set1_epi16(255 - alpha);
+        const __m128i half = _mm_set1_epi16(128);
+        for (; i + 16 <= bytes; i += 16)
+        {
+            __m128i sv = _mm_loadu_si128((const __m128i *)(s + i));
+            __m128i dv = _mm_loadu_si128((const __m128i *)(d + i));
+            __m128i r[2];
+            for (int k = 0; k < 2; k++)
+            {
+                __m128i s16 = k == 0 ? _mm_unpacklo_epi8(sv, zero) : _mm_unpackhi_epi8(sv, zero);
+                __m128i d16 = k == 0 ? _mm_unpacklo_epi8(dv, zero) : _mm_unpackhi_epi8(dv, zero);
+                __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s16, a), _mm_mullo_epi16(d16, b)), half);
+                r[k] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            }
+            _mm_storeu_si128((__m128i *)(d + i), _mm_packus_epi16(r[0], r[1]));
+        }
+#elif defined(__aarch64__)
+        const uint8x8_t a = vdup_n_u8(alpha), b = vdup_n_u8(255 - alpha);
+        const uint16x8_t half = vdupq_n_u16(128);
+        for (; i + 16 <= bytes; i += 16)
+        {
+            uint8x16_t sv = vld1q_u8(s + i), dv = vld1q_u8(d + i);
+            uint16x8_t lo = vaddq_u16(vmlal_u8(vmull_u8(vget_low_u8(sv), a), vget_low_u8(dv), b), half);
+            uint16x8_t hi = vaddq_u16(vmlal_u8(vmull_u8(vget_high_u8(sv), a), vget_high_u8(dv), b), half);
+            lo = vshrq_n_u16(vaddq_u16(lo, vshrq_n_u16(lo, 8)), 8);
+            hi = vshrq_n_u16(vaddq_u16(hi, vshrq_n_u16(hi, 8)), 8);
+            vst1q_u8(d + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+        }
+#endif
+        for (; i < bytes; i++)
+        {
+            unsigned t = s[i] * alpha + d[i] * (255u - alpha) + 128;
+            d[i] = (uint8_t)((t + (t >> 8)) >> 8);
+        }
+    }
+
+    // Legacy floating-point ellipse predicate, used to resolve pixels lying
+    // (within rounding error) on the ellipse boundary in EllipseMode::Exact.
+    static bool legacy_ellipse_inside(long long x, long long y, long long rx, long long ry)
+    {
+        double vy = (double)y / (double)ry;
+        vy *= vy;
+        double vx = (double)x / (double)rx;
+        vx *= vx;
+        return vx + vy <= 1;
+    }
+
+    // Ellipse errors reach rx^2 * ry^2, past 64 bits once both radii pass
+    // about 55000; __int128 holds them for any int radii.
+    __extension__ typedef __int128 EllipseError;
+
+    // Decide if (x, y) is inside the ellipse, given
+    // err = x^2 * ry^2 + y^2 * rx^2 - rx^2 * ry^2.
+    static bool ellipse_inside(EllipseError err, long long x, long long y,
+                               long long rx, long long ry, EllipseMode mode)
+    {
+        // Errors this close to zero may be classified differently by the
+        // floating-point predicate (only non-zero for very large radii).
+        EllipseError tie = ((EllipseError)(rx * rx) * (ry * ry)) >> 48;
+        if (mode == EllipseMode::Exact && err >= -tie && err <= tie)
+        {
+            return legacy_ellipse_inside(x, y, rx, ry);
+        }
+        return err <= 0;
+    }
+
+    int PNGImage::ellipse_half_width(const Point &radius, int y, EllipseMode mode)
+    {
+        long long rx = std::abs(radius.x), ry = std::abs(radius.y);
+        long long ay = std::abs(y);
+        if (ay > ry)
+        {
+            return -1;
+        }
+        if (ay == 0)
+        {
+            return (int)rx;
+        }
+        EllipseError rx2 = rx * rx, ry2 = ry * ry;
+        // Start from the real-valued width, then settle on the largest
+        // x that draw_ellipse() would reach (x = 0 is never tested there).
+        long long x = (long long)(rx * ::sqrt(std::max(0.0, 1.0 - (double)(ay * ay) / (double)(ry * ry))));
+        x = std::min(std::max(x, 0LL), rx);
+        EllipseError base = ay * ay * rx2 - rx2 * ry2;
+        while (x < rx && ellipse_inside((x + 1) * (x + 1) * ry2 + base, x + 1, ay, rx, ry, mode))
+        {
+            x++;
+        }
+        while (x > 0 && !ellipse_inside(x * x * ry2 + base, x, ay, rx, ry, mode))
+        {
+            x--;
+        }
+        return (int)x;
+    }
+
+    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill,
+                                EllipseMode mode)
+    {
+        //  Midpoint algorithm: for each row y, keep the largest x such that
+        //  err = x^2 * ry^2 + y^2 * rx^2 - rx^2 * ry^2 <= 0, updating err
+        //  incrementally as y grows and x shrinks.
+        long long rx = std::abs(radius.x), ry = std::abs(radius.y);
+        EllipseError rx2 = rx * rx, ry2 = ry * ry;
+        long long x = rx;
+        EllipseError err = 0;
+        fill_span(center.x - x, center.x + x, center.y, fill);
+        for (long long y = 1; y <= ry; y++)
+        {
+            if ((y & 63) == 0)
+            {
+                check_cancelled(cancel_);
+            }
+            err += (2 * y - 1) * rx2;
+            while (x > 0 && !ellipse_inside(err, x, y, rx, ry, mode))
+            {
+                err -= (2 * x - 1) * ry2;
+                x--;
             }
-            dx = x0 - x1;
-            x0 = x1;
-            draw_line(center.translate({-x0, -y}),
-                      center.translate({+x0, -y}),
-                      fill);
-            draw_line(center.translate({-x0, +y}),
-                      center.translate({+x0, +y}),
-                      fill);
+            fill_span(center.x - x, center.x + x, center.y - y, fill);
+            fill_span(center.x - x, center.x + x, center.y + y, fill);
         }
     }
 
-}
+}
\ No newline at end of file
@@ -2,14 +2,67 @@
 #ifndef __svg_png_image_hpp__
 #define __svg_png_image_hpp__
 
+#include "Cancellation.hpp"
 #include "Color.hpp"
+#include "PathData.hpp"
 #include "Point.hpp"
+#include "PixelStore.hpp"
+#include "Stroke.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace svg
 {
+    //! Ellipse rasterization mode.
+    enum class EllipseMode
+    {
+        //! Integer midpoint test; boundary pixels (exactly on the
+        //! ellipse) are resolved with the legacy floating-point
+        //! predicate, so output is pixel-identical to earlier versions.
+        Exact,
+        //! Pure integer midpoint test; boundary pixels are inside.
+        Midpoint
+    };
+
+    //! Storage of the pixels of an image.
+    enum class PixelStorage
+    {
+        //! One RGB triple per pixel, row by row.
+        Dense,
+        //! Runs of one color per row (see RunBuffer): memory and saving
+        //! time follow the number of color changes, which suits large
+        //! canvases with a few flat shapes.
+        Runs,
+        //! Square tiles allocated on first write (see TileBuffer): memory
+        //! follows the area drawn on, which suits very large canvases.
+        Tiles,
+        //! One RGB triple per pixel in 8x8 blocks: pixels near in both
+        //! directions share cache lines, which suits steep lines and
+        //! tall shapes.
+        Blocks8,
+        //! One RGB triple per pixel in 16x16 blocks.
+        Blocks16
+    };
+
+    //! Source of the colors of filled pixels, computed a row span at
+    //! a time.
+    class SpanShader
+    {
+    public:
+        //! Destructor.
+        virtual ~SpanShader();
+        //! Compute the colors of consecutive pixels of a row.
+        //! @param x X position of the first pixel (document coordinates).
+        //! @param y Y position (document coordinates).
+        //! @param n Number of pixels.
+        //! @param out Output colors.
+        virtual void shade(int x, int y, int n, Color *out) const = 0;
+    };
+
     //! PNG image.
     class PNGImage
     {
@@ -22,6 +75,21 @@ namespace svg
         //! @param w Image width.
         //! @param h Image height.
         PNGImage(int w, int h);
+        //! Constructor of blank image with a given pixel storage.
+        //! Initally, all pixels will be white.
+        //! @param w Image width.
+        //! @param h Image height.
+        //! @param storage Pixel storage.
+        PNGImage(int w, int h, PixelStorage storage);
+        //! Move constructor; the source image is left empty (0 x 0).
+        //! @param other Image to move from.
+        PNGImage(PNGImage &&other);
+        //! Move assignment; the source image is left empty (0 x 0).
+        //! @param other Image to move from.
+        //! @return This image.
+        PNGImage &operator=(PNGImage &&other);
+        PNGImage(const PNGImage &) = delete;
+        PNGImage &operator=(const PNGImage &) = delete;
         //! Destructor.
         ~PNGImage();
         //! Get image width.
@@ -30,7 +98,33 @@ namespace svg
         //! Get image height.
         //! @return The image height.
         int height() const;
-        //! Get mutable reference to image pixel.
+        //! Get pixel storage.
+        //! @return The pixel storage.
+        PixelStorage storage() const;
+        //! Get drawing origin.
+        //! @return Document position of pixel (0, 0).
+        Point origin() const;
+        //! Set drawing origin, so that the image holds the region of
+        //! the document starting at that position.
+        //! Drawing operations use document coordinates and are
+        //! clipped to the region; at() is not affected.
+        //! @param o Document position of pixel (0, 0).
+        void set_origin(const Point &o);
+        //! Set the token polled by the drawing loops, which then throw
+        //! RenderCancelled once it fires.
+        //! @param token Token, or nullptr to draw without checks.
+        void set_cancellation(const CancellationToken *token);
+        //! Set the shader coloring the pixels of the drawing operations
+        //! in place of their color argument.
+        //! @param shader Shader, or nullptr to draw with plain colors.
+        void set_shader(const SpanShader *shader);
+        //! Set all pixels to white, the origin to (0, 0), and remove
+        //! the cancellation token and the shader.
+        //! Only the pixels written since the image was last blank are
+        //! cleared.
+        void clear();
+        //! Get mutable reference to image pixel; not available with run
+        //! storage, which is not addressable.
         //! @param x X position
         //! @param y Y position.
         //! @return Reference to pixel.
@@ -40,32 +134,193 @@ namespace svg
         //! @param y Y position.
         //! @return Reference to pixel.
         Color at(int x, int y) const;
-        //! Save to output file.
+        //! Get the pixels of a row.
+        //! @param y Y position.
+        //! @return Pointer to the width() pixels of row y; with other
+        //!         than dense storage, the row is expanded into a buffer
+        //!         valid until the next call or change to the image.
+        const Color *row(int y) const;
+        //! Hash of the image size and pixels (see hash64()); equal
+        //! images have equal hashes, whatever their origin, buffer or
+        //! storage (other than dense storage is expanded to compute it).
+        //! @return Hash value.
+        uint64_t hash() const;
+        //! Save to output file; other than dense storage is written row
+        //! by row with PNGStreamWriter, from the runs of each row.
         //! @param png_file_name Output file name.
+        //! @throw std::runtime_error if the file could not be written.
         void save(const std::string &png_file_name) const;
+        //! Save to output file as an indexed-color PNG (1, 2, 4 or 8
+        //! bits per pixel; 8 but for dense storage) if the image has at most
+        //! 256 colors, or as RGB otherwise.
+        //! @param png_file_name Output file name.
+        //! @param colors Colors expected in the image (see
+        //!        Scene::palette()); colors not listed are added as found,
+        //!        and listed colors no pixel has are dropped.
+        //! @return true if the image was saved with a palette.
+        //! @throw std::runtime_error if the file could not be written.
+        bool save_indexed(const std::string &png_file_name,
+                          const std::vector<Color> &colors = std::vector<Color>()) const;
         //! Draw a line defined by 2 points.
         //! @param a First point.
         //! @param b Second point.
         //! @param c Color to use for the line.
         void draw_line(const Point &a, const Point &b, const Color &c);
+        //! Draw a polyline. Thin strokes are drawn with draw_line()
+        //! (shared vertices written once); wide strokes are filled as
+        //! the union of segment bodies, joins and caps, row by row.
+        //! @param points Vector of points defining the polyline.
+        //! @param c Color to use for the polyline.
+        //! @param style Stroke style.
+        void draw_polyline(const std::vector<Point> &points, const Color &c,
+                           const StrokeStyle &style);
         //! Draw a polygon.
         //! @param points Vector of points defining the polygon.
         //! @param fill Color to use for the polygon fill.
         void draw_polygon(const std::vector<Point> &points, const Color &fill);
+        //! Fill the area enclosed by contours (see ContourFill).
+        //! @param contours Contours, each implicitly closed.
+        //! @param rule Fill rule.
+        //! @param fill Color to use for the fill.
+        void fill_contours(const std::vector<Contour> &contours, FillRule rule, const Color &fill);
         //! Draw an ellipse.
         //! @param center Coordinates for the ellipse center.
         //! @param radius Radius in X and Y axis.
         //! @param fill Color to use for the ellipse fill.
-        //! @param orientation ellipse orientation.
-        void draw_ellipse(const Point &center, const Point &radius, const Color &fill);
+        //! @param mode Rasterization mode.
+        void draw_ellipse(const Point &center, const Point &radius, const Color &fill,
+                          EllipseMode mode = EllipseMode::Exact);
+        //! Fill a horizontal span, clipped to the image.
+        //! Coordinates are document coordinates (see set_origin()).
+        //! @param x0 First X position.
+        //! @param x1 Last X position (inclusive).
+        //! @param y Y position.
+        //! @param c Color to use for the span.
+        void fill_span(int x0, int x1, int y, const Color &c);
+        //! Start drawing translucent content: copy a region of the
+        //! image into a layer, to be drawn on opaquely and then
+        //! blended back with end_layer(). Each pixel is blended once,
+        //! however many times the content draws it.
+        //! @param box Region in document coordinates; clipped to the image.
+        //! @return Layer holding the region (with its origin and the
+        //!         cancellation token of this image), or nullptr if the
+        //!         region lies outside the image.
+        std::unique_ptr<PNGImage> begin_layer(const BoundingBox &box) const;
+        //! Blend a layer from begin_layer() back into the image.
+        //! @param layer Layer.
+        //! @param opacity Opacity of the layer contents, in [0, 1].
+        void end_layer(const PNGImage &layer, double opacity);
+        //! Blend pixels source-over with a uniform opacity:
+        //! dst = (src * alpha + dst * (255 - alpha)) / 255, rounded.
+        //! @param dst Destination pixels.
+        //! @param src Source pixels.
+        //! @param n Number of pixels.
+        //! @param alpha Source opacity (0 to 255).
+        static void blend_pixels(Color *dst, const Color *src, size_t n, uint8_t alpha);
+
+        //! Half-width of the ellipse row drawn by draw_ellipse().
+        //! @param radius Radius in X and Y axis.
+        //! @param y Row offset from the center.
+        //! @param mode Rasterization mode.
+        //! @return Half-width of the row, or -1 if the row is not drawn.
+        static int ellipse_half_width(const Point &radius, int y,
+                                      EllipseMode mode = EllipseMode::Exact);
+        //! Check if draw_line() sets some pixel in a region.
+        //! @param a First point.
+        //! @param b Second point.
+        //! @param region Region.
+        //! @return true if some pixel of the line lies in the region.
+        static bool line_hits(const Point &a, const Point &b, const BoundingBox &region);
+        //! Compute the fill spans of a polygon row, as drawn by draw_polygon().
+        //! The polygon outline is drawn separately.
+        //! @param points Vector of points defining the polygon.
+        //! @param y Y position.
+        //! @param seg Scratch storage for edge intersections.
+        //! @param spans Output spans, each given as a point (first X, last X).
+        static void polygon_spans(const std::vector<Point> &points, int y,
+                                  std::vector<double> &seg, std::vector<Point> &spans);
 
     private:
+        //! Draw a line with the Bresenham algorithm.
+        //! @param a First point.
+        //! @param b Second point.
+        //! @param c Color to use for the line.
+        //! @param skip_first Do not set the pixel at a.
+        void draw_segment(const Point &a, const Point &b, const Color &c, bool skip_first);
+        //! Constructor taking ownership of a white pixel buffer.
+        //! @param pixels Buffer of capacity pixels, all white.
+        //! @param capacity Buffer size in pixels (at least w * h).
+        //! @param w Image width.
+        //! @param h Image height.
+        PNGImage(Color *pixels, size_t capacity, int w, int h);
+        //! Record that pixels [begin, end) of the buffer were written.
+        //! @param begin First pixel index.
+        //! @param end Past-the-end pixel index.
+        void touch(size_t begin, size_t end);
+        //! Buffer index of a pixel of dense or blocked storage.
+        //! @param x X position in the image.
+        //! @param y Y position in the image.
+        //! @return Pixel index, increasing with x along a row.
+        size_t offset(int x, int y) const
+        {
+            if (block_shift_ == 0)
+            {
+                return (size_t)y * width_ + x;
+            }
+            return ((size_t)(y >> block_shift_) * block_columns_ + (size_t)(x >> block_shift_))
+                       << (2 * block_shift_) |
+                   (size_t)((y & block_mask_) << block_shift_ | (x & block_mask_));
+        }
+        //! End of the run of buffer-contiguous pixels of a row.
+        //! @param x First pixel of the run.
+        //! @param end Past-the-end pixel of the span holding the run.
+        //! @return Past-the-end pixel of the run, at most end.
+        int contiguous_end(int x, int end) const
+        {
+            return block_shift_ == 0 ? end : std::min(end, (x | block_mask_) + 1);
+        }
+        //! Save other than dense storage as an indexed-color PNG.
+        //! @param png_file_name Output file name.
+        //! @param colors Colors expected in the image.
+        //! @return true if the image was saved with a palette.
+        bool save_store_indexed(const std::string &png_file_name,
+                                const std::vector<Color> &colors) const;
+        //! Set a pixel given in document coordinates, if visible.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @param c Color.
+        void plot(int x, int y, const Color &c);
+
         //! Width.
         int width_;
         //! Height.
         int height_;
-        //! Pixels.
+        //! Pixels, or nullptr with other than dense or blocked storage.
         Color *pixels_;
+        //! Pixels, with other than dense storage.
+        std::unique_ptr<PixelStore> store_;
+        //! Pixel storage.
+        PixelStorage storage_;
+        //! Scratch pixels of other than row-order storage (see row()).
+        mutable std::vector<Color> row_buffer_;
+        //! Drawing origin.
+        Point origin_;
+        //! Buffer size in pixels.
+        size_t capacity_;
+        //! Range of buffer pixels written since the buffer was last white.
+        size_t dirty_begin_, dirty_end_;
+        //! Log2 of the block size of blocked storage, 0 for row order.
+        int block_shift_;
+        //! Block size minus one of blocked storage.
+        int block_mask_;
+        //! Blocks per block row of blocked storage.
+        size_t block_columns_;
+        //! Cancellation token, or nullptr.
+        const CancellationToken *cancel_;
+        //! Shader, or nullptr.
+        const SpanShader *shader_;
+
+        friend class FramebufferPool;
     };
 }
 
@@ -0,0 +1,506 @@
+//! @file PNGWriter.cpp
+#include "PNGWriter.hpp"
+
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "external/stb/stb_image_write.h"
+
+// Defined by the stb_image_write implementation (see PNGImage.cpp),
+// which does not declare it in its header part.
+extern "C" unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+namespace svg
+{
+    const size_t Palette::MAX_COLORS;
+    const size_t Palette::TABLE_SIZE;
+
+    // Packed color, never 0.
+    static uint32_t color_key(const Color &c)
+    {
+        return 0x1000000u | (uint32_t)c.red << 16 | (uint32_t)c.green << 8 | c.blue;
+    }
+
+    Palette::Palette()
+    {
+        std::memset(keys_, 0, sizeof(keys_));
+        std::memset(indices_, 0, sizeof(indices_));
+    }
+
+    size_t Palette::slot(uint32_t key) const
+    {
+        size_t i = (key * 2654435761u) >> 23 & (TABLE_SIZE - 1);
+        while (keys_[i] != 0 && keys_[i] != key)
+        {
+            i = (i + 1) & (TABLE_SIZE - 1);
+        }
+        return i;
+    }
+
+    int Palette::add(const Color &c)
+    {
+        uint32_t key = color_key(c);
+        size_t i = slot(key);
+        if (keys_[i] == key)
+        {
+            return indices_[i];
+        }
+        if (colors_.size() == MAX_COLORS)
+        {
+            return -1;
+        }
+        keys_[i] = key;
+        indices_[i] = (uint8_t)colors_.size();
+        colors_.push_back(c);
+        return indices_[i];
+    }
+
+    int Palette::find(const Color &c) const
+    {
+        uint32_t key = color_key(c);
+        size_t i = slot(key);
+        return keys_[i] == key ? indices_[i] : -1;
+    }
+
+    const std::vector<Color> &Palette::colors() const
+    {
+        return colors_;
+    }
+
+    int Palette::bit_depth() const
+    {
+        size_t n = colors_.size();
+        return n <= 2 ? 1 : n <= 4 ? 2 : n <= 16 ? 4 : 8;
+    }
+
+    // Table of the CRC-32 of PNG chunks (ISO 3309).
+    struct CrcTable
+    {
+        uint32_t entries[256];
+        CrcTable()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+        }
+    };
+
+    // Update a CRC-32 (before its final inversion) with bytes.
+    static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t n)
+    {
+        static const CrcTable table;
+        for (size_t i = 0; i < n; i++)
+        {
+            crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    // CRC-32 of bytes.
+    static uint32_t crc32(const uint8_t *data, size_t n)
+    {
+        return ~crc32_update(0xFFFFFFFFu, data, n);
+    }
+
+    // Append a big-endian 32-bit value.
+    static void put32(std::vector<uint8_t> &out, uint32_t v)
+    {
+        out.push_back((uint8_t)(v >> 24));
+        out.push_back((uint8_t)(v >> 16));
+        out.push_back((uint8_t)(v >> 8));
+        out.push_back((uint8_t)v);
+    }
+
+    // Append a chunk: length, type, data and CRC of type and data.
+    static void put_chunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data, size_t n)
+    {
+        put32(out, (uint32_t)n);
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        if (n > 0)
+        {
+            out.insert(out.end(), data, data + n);
+        }
+        put32(out, crc32(out.data() + start, n + 4));
+    }
+
+    bool stb_can_encode(int width, int height, int bytes_per_pixel)
+    {
+        return ((size_t)width * bytes_per_pixel + 1) * height <= (size_t)INT_MAX / 4;
+    }
+
+    bool write_indexed_png(const std::string &file_name, int width, int height,
+                           const Palette &palette, const uint8_t *indices)
+    {
+        if (!stb_can_encode(width, height, 1))
+        {
+            return false;
+        }
+        static const uint8_t SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        int depth = palette.bit_depth();
+        const std::vector<Color> &colors = palette.colors();
+
+        // Rows: filter type 0, then the indices packed high bits first.
+        size_t row_bytes = ((size_t)width * depth + 7) / 8;
+        std::vector<uint8_t> raw(((row_bytes + 1) * height));
+        int per_byte = 8 / depth;
+        for (int y = 0; y < height; y++)
+        {
+            uint8_t *out = raw.data() + (row_bytes + 1) * y + 1;
+            const uint8_t *in = indices + (size_t)width * y;
+            if (depth == 8)
+            {
+                std::memcpy(out, in, width);
+                continue;
+            }
+            for (int x = 0; x < width; x += per_byte)
+            {
+                uint8_t packed = 0;
+                for (int k = 0; k < per_byte; k++)
+                {
+                    packed = (uint8_t)(packed << depth | (x + k < width ? in[x + k] : 0));
+                }
+                *out++ = packed;
+            }
+        }
+        int zlen = 0;
+        unsigned char *zlib = stbi_zlib_compress(raw.data(), (int)raw.size(), &zlen,
+                                                 stbi_write_png_compression_level);
+        if (zlib == nullptr)
+        {
+            return false;
+        }
+
+        std::vector<uint8_t> png(SIGNATURE, SIGNATURE + 8);
+        std::vector<uint8_t> header;
+        put32(header, (uint32_t)width);
+        put32(header, (uint32_t)height);
+        uint8_t fields[] = {(uint8_t)depth, 3, 0, 0, 0}; // Indexed color, no interlace
+        header.insert(header.end(), fields, fields + 5);
+        put_chunk(png, "IHDR", header.data(), header.size());
+        std::vector<uint8_t> plte;
+        for (const Color &c : colors)
+        {
+            plte.push_back(c.red);
+            plte.push_back(c.green);
+            plte.push_back(c.blue);
+        }
+        put_chunk(png, "PLTE", plte.data(), plte.size());
+        put_chunk(png, "IDAT", zlib, zlen);
+        std::free(zlib);
+        put_chunk(png, "IEND", nullptr, 0);
+
+        FILE *f = std::fopen(file_name.c_str(), "wb");
+        if (f == nullptr)
+        {
+            return false;
+        }
+        bool ok = std::fwrite(png.data(), 1, png.size(), f) == png.size();
+        return std::fclose(f) == 0 && ok;
+    }
+
+    // Deflate stream bytes written per IDAT chunk.
+    static const size_t CHUNK_SIZE = 1 << 16;
+    // Modulus of the Adler-32 sums.
+    static const uint64_t ADLER_MOD = 65521;
+    // Base lengths and extra bits of the deflate length symbols 257 to 285.
+    static const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    // Base distances and extra bits of the deflate distance codes.
+    static const int DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                          193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                          6145, 8193, 12289, 16385, 24577};
+    static const int DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                           6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    // Reverse the low bits of a Huffman code (deflate writes codes
+    // high bit first into a low-bit-first stream).
+    static uint32_t reverse_bits(uint32_t code, int count)
+    {
+        uint32_t r = 0;
+        for (int i = 0; i < count; i++)
+        {
+            r = r << 1 | (code >> i & 1);
+        }
+        return r;
+    }
+
+    // Index of the last table entry not above a value.
+    static int table_index(const int *base, int n, int value)
+    {
+        int i = n - 1;
+        while (base[i] > value)
+        {
+            i--;
+        }
+        return i;
+    }
+
+    static bool same_runs(const ColorRun *a, const ColorRun *b, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (a[i].x != b[i].x || a[i].color.red != b[i].color.red ||
+                a[i].color.green != b[i].color.green || a[i].color.blue != b[i].color.blue)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PNGStreamWriter::PNGStreamWriter(const std::string &file_name, int width, int height,
+                                     const Palette *palette)
+        : file_(std::fopen(file_name.c_str(), "wb")), failed_(false),
+          width_(width), height_(height), rows_(0), palette_(palette),
+          pixel_bytes_(palette != nullptr ? 1 : 3), bit_buffer_(0), bit_count_(0),
+          adler_a_(1), adler_b_(0)
+    {
+        static const uint8_t SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        if (file_ == nullptr)
+        {
+            failed_ = true;
+            return;
+        }
+        failed_ = std::fwrite(SIGNATURE, 1, 8, file_) != 8;
+        std::vector<uint8_t> header;
+        put32(header, (uint32_t)width);
+        put32(header, (uint32_t)height);
+        uint8_t fields[] = {8, (uint8_t)(palette != nullptr ? 3 : 2), 0, 0, 0};
+        header.insert(header.end(), fields, fields + 5);
+        write_chunk("IHDR", header.data(), header.size());
+        if (palette != nullptr)
+        {
+            std::vector<uint8_t> plte;
+            for (const Color &c : palette->colors())
+            {
+                plte.push_back(c.red);
+                plte.push_back(c.green);
+                plte.push_back(c.blue);
+            }
+            write_chunk("PLTE", plte.data(), plte.size());
+        }
+        // zlib header (deflate, 32K window), then a single final block
+        // with the fixed Huffman codes.
+        pending_.push_back(0x78);
+        pending_.push_back(0x01);
+        put_bits(1, 1);
+        put_bits(1, 2);
+    }
+
+    PNGStreamWriter::~PNGStreamWriter()
+    {
+        if (file_ != nullptr)
+        {
+            std::fclose(file_);
+        }
+    }
+
+    void PNGStreamWriter::put_bits(uint32_t bits, int count)
+    {
+        bit_buffer_ |= bits << bit_count_;
+        bit_count_ += count;
+        while (bit_count_ >= 8)
+        {
+            pending_.push_back((uint8_t)bit_buffer_);
+            bit_buffer_ >>= 8;
+            bit_count_ -= 8;
+        }
+    }
+
+    void PNGStreamWriter::put_symbol(int symbol)
+    {
+        if (symbol < 144)
+        {
+            put_bits(reverse_bits(0x30 + symbol, 8), 8);
+        }
+        else if (symbol < 256)
+        {
+            put_bits(reverse_bits(0x190 + symbol - 144, 9), 9);
+        }
+        else if (symbol < 280)
+        {
+            put_bits(reverse_bits(symbol - 256, 7), 7);
+        }
+        else
+        {
+            put_bits(reverse_bits(0xC0 + symbol - 280, 8), 8);
+        }
+    }
+
+    void PNGStreamWriter::put_match(size_t length, int distance)
+    {
+        int d = table_index(DISTANCE_BASE, 30, distance);
+        while (length > 0)
+        {
+            size_t piece = length < 258 ? length : 258;
+            if (length - piece > 0 && length - piece < 3)
+            {
+                piece = length - 3; // Leave a last match of at least 3 bytes
+            }
+            int l = table_index(LENGTH_BASE, 29, (int)piece);
+            put_symbol(257 + l);
+            put_bits((uint32_t)piece - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+            put_bits(reverse_bits(d, 5), 5);
+            put_bits((uint32_t)(distance - DISTANCE_BASE[d]), DISTANCE_EXTRA[d]);
+            length -= piece;
+        }
+    }
+
+    void PNGStreamWriter::checksum_repeat(const uint8_t *bytes, int size, size_t count)
+    {
+        // Adler-32 over count copies of the bytes, in closed form: byte t
+        // of copy j is followed by m - j * size - t bytes (m in total).
+        uint64_t m = (uint64_t)count * size;
+        uint64_t copies = count % ADLER_MOD;
+        uint64_t pairs = ((uint64_t)count * (count - 1) / 2) % ADLER_MOD;
+        uint64_t a = adler_a_, b = adler_b_;
+        b = (b + m % ADLER_MOD * a) % ADLER_MOD;
+        for (int t = 0; t < size; t++)
+        {
+            uint64_t weight = (copies * ((m - t) % ADLER_MOD) + ADLER_MOD - size * pairs % ADLER_MOD) % ADLER_MOD;
+            b = (b + bytes[t] * weight) % ADLER_MOD;
+            a = (a + bytes[t] * copies) % ADLER_MOD;
+        }
+        adler_a_ = (uint32_t)a;
+        adler_b_ = (uint32_t)b;
+    }
+
+    void PNGStreamWriter::put_repeat(const uint8_t *bytes, size_t count)
+    {
+        checksum_repeat(bytes, pixel_bytes_, count);
+        for (int t = 0; t < pixel_bytes_; t++)
+        {
+            put_symbol(bytes[t]);
+        }
+        size_t rest = (count - 1) * pixel_bytes_;
+        if (rest >= 3)
+        {
+            put_match(rest, pixel_bytes_);
+            return;
+        }
+        for (size_t i = 0; i < rest; i++)
+        {
+            put_symbol(bytes[i % pixel_bytes_]);
+        }
+    }
+
+    void PNGStreamWriter::write_row(const ColorRun *runs, size_t n)
+    {
+        if (failed_ || rows_ == height_)
+        {
+            failed_ = true;
+            return;
+        }
+        static const uint8_t FILTER_NONE = 0;
+        size_t stride = 1 + (size_t)width_ * pixel_bytes_;
+        bool repeat = rows_ > 0 && stride >= 3 && stride <= 32768 &&
+                      n == previous_.size() && same_runs(runs, previous_.data(), n);
+        if (repeat)
+        {
+            put_match(stride, (int)stride);
+        }
+        else
+        {
+            put_symbol(FILTER_NONE);
+        }
+        checksum_repeat(&FILTER_NONE, 1, 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            const Color &c = runs[i].color;
+            uint8_t bytes[3] = {c.red, c.green, c.blue};
+            if (palette_ != nullptr)
+            {
+                int index = palette_->find(c);
+                assert(index >= 0);
+                bytes[0] = (uint8_t)index;
+            }
+            size_t count = (i + 1 < n ? runs[i + 1].x : width_) - runs[i].x;
+            if (repeat)
+            {
+                checksum_repeat(bytes, pixel_bytes_, count);
+            }
+            else
+            {
+                put_repeat(bytes, count);
+            }
+        }
+        previous_.assign(runs, runs + n);
+        rows_++;
+        if (pending_.size() >= CHUNK_SIZE)
+        {
+            flush_chunk();
+        }
+    }
+
+    void PNGStreamWriter::write_row(const Color *pixels)
+    {
+        runs_.clear();
+        for (int x = 0; x < width_; x++)
+        {
+            const Color &c = pixels[x];
+            if (runs_.empty() || runs_.back().color.red != c.red ||
+                runs_.back().color.green != c.green || runs_.back().color.blue != c.blue)
+            {
+                runs_.push_back({x, c});
+            }
+        }
+        write_row(runs_.data(), runs_.size());
+    }
+
+    void PNGStreamWriter::flush_chunk()
+    {
+        write_chunk("IDAT", pending_.data(), pending_.size());
+        pending_.clear();
+    }
+
+    void PNGStreamWriter::write_chunk(const char *type, const uint8_t *data, size_t n)
+    {
+        if (failed_)
+        {
+            return;
+        }
+        uint8_t head[8];
+        for (int i = 0; i < 4; i++)
+        {
+            head[i] = (uint8_t)(n >> (24 - 8 * i));
+            head[4 + i] = (uint8_t)type[i];
+        }
+        uint32_t crc = ~crc32_update(crc32_update(0xFFFFFFFFu, head + 4, 4), data, n);
+        uint8_t tail[4] = {(uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc};
+        failed_ = std::fwrite(head, 1, 8, file_) != 8 ||
+                  (n > 0 && std::fwrite(data, 1, n, file_) != n) ||
+                  std::fwrite(tail, 1, 4, file_) != 4;
+    }
+
+    bool PNGStreamWriter::finish()
+    {
+        if (file_ == nullptr)
+        {
+            return false;
+        }
+        failed_ = failed_ || rows_ != height_;
+        put_symbol(256); // End of block
+        if (bit_count_ > 0)
+        {
+            put_bits(0, 8 - bit_count_);
+        }
+        put32(pending_, adler_b_ << 16 | adler_a_);
+        flush_chunk();
+        write_chunk("IEND", nullptr, 0);
+        bool closed = std::fclose(file_) == 0;
+        file_ = nullptr;
+        return closed && !failed_;
+    }
+}
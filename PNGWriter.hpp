@@ -0,0 +1,165 @@
+//! @file PNGWriter.hpp
+#ifndef __svg_PNGWriter_hpp__
+#define __svg_PNGWriter_hpp__
+
+#include "Color.hpp"
+#include "PixelStore.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Colors of an indexed image, with a hash table mapping colors to
+    //! their indices.
+    class Palette
+    {
+    public:
+        //! Maximum number of colors of a PNG palette.
+        static const size_t MAX_COLORS = 256;
+
+        //! Constructor of an empty palette.
+        Palette();
+        //! Add a color, if not present.
+        //! @param c Color.
+        //! @return Index of the color, or -1 if the palette is full.
+        int add(const Color &c);
+        //! Find a color.
+        //! @param c Color.
+        //! @return Index of the color, or -1 if absent.
+        int find(const Color &c) const;
+        //! Get the colors.
+        //! @return The colors, by index.
+        const std::vector<Color> &colors() const;
+        //! Smallest PNG bit depth (1, 2, 4 or 8) holding all indices.
+        //! @return Bit depth.
+        int bit_depth() const;
+
+    private:
+        //! Size of the hash table (twice the maximum number of colors).
+        static const size_t TABLE_SIZE = 2 * MAX_COLORS;
+        //! Slot of a color in the hash table.
+        //! @param key Packed color.
+        //! @return Slot holding the color, or the empty slot it would go in.
+        size_t slot(uint32_t key) const;
+
+        //! Colors, by index.
+        std::vector<Color> colors_;
+        //! Hash table of packed colors (0 for empty slots, else
+        //! 0x1000000 | rgb) and their indices.
+        uint32_t keys_[TABLE_SIZE];
+        //! Index of the color in each slot.
+        uint8_t indices_[TABLE_SIZE];
+    };
+
+    //! Whether stb_image_write can deflate the rows of an image: it sizes
+    //! its buffers with int and grows them by doubling, so larger images
+    //! are written with PNGStreamWriter.
+    //! @param width Image width.
+    //! @param height Image height.
+    //! @param bytes_per_pixel Bytes per pixel.
+    //! @return true if the unfiltered rows fit.
+    bool stb_can_encode(int width, int height, int bytes_per_pixel);
+
+    //! Write an indexed-color PNG file: one palette index per pixel,
+    //! packed at the bit depth of the palette, rows unfiltered and
+    //! deflated at stbi_write_png_compression_level.
+    //! @param file_name File name.
+    //! @param width Image width.
+    //! @param height Image height.
+    //! @param palette Palette (1 to 256 colors).
+    //! @param indices width * height indices, row by row.
+    //! @return true if the file was written (false if too large for
+    //! stb_can_encode).
+    bool write_indexed_png(const std::string &file_name, int width, int height,
+                           const Palette &palette, const uint8_t *indices);
+
+    //! PNG writer taking the rows of an image one at a time, as runs of
+    //! one color, and deflating them as they come, so that memory does
+    //! not depend on the image size. Rows are unfiltered and deflated
+    //! with the fixed Huffman codes, without match search: each run is
+    //! its first pixel followed by a match repeating it, and a row equal
+    //! to the previous one is a single match.
+    class PNGStreamWriter
+    {
+    public:
+        //! Constructor; opens the file and writes the header.
+        //! @param file_name File name.
+        //! @param width Image width.
+        //! @param height Image height.
+        //! @param palette Palette of an indexed-color image (8 bits per
+        //! pixel), or nullptr for RGB; must outlive the writer.
+        PNGStreamWriter(const std::string &file_name, int width, int height,
+                        const Palette *palette = nullptr);
+        //! Destructor; closes the file, complete or not.
+        ~PNGStreamWriter();
+        PNGStreamWriter(const PNGStreamWriter &) = delete;
+        PNGStreamWriter &operator=(const PNGStreamWriter &) = delete;
+        //! Write the next row.
+        //! @param runs Runs covering the row, the first at X 0 (with
+        //! colors in the palette, if any).
+        //! @param n Number of runs.
+        void write_row(const ColorRun *runs, size_t n);
+        //! Write the next row.
+        //! @param pixels Pixels of the row.
+        void write_row(const Color *pixels);
+        //! Write the end of the file and close it.
+        //! @return true if all rows were given and the file was written.
+        bool finish();
+
+    private:
+        //! Append bits to the deflate stream, low bits first.
+        //! @param bits Bits.
+        //! @param count Number of bits.
+        void put_bits(uint32_t bits, int count);
+        //! Append a literal/length symbol.
+        //! @param symbol Symbol (0 to 287).
+        void put_symbol(int symbol);
+        //! Append matches copying bytes.
+        //! @param length Number of bytes (at least 3).
+        //! @param distance Distance (1 to 32768).
+        void put_match(size_t length, int distance);
+        //! Append the bytes of a pixel repeated, and count them in the
+        //! checksum.
+        //! @param bytes Pixel bytes.
+        //! @param count Number of pixels.
+        void put_repeat(const uint8_t *bytes, size_t count);
+        //! Count repeated bytes in the checksum.
+        //! @param bytes Bytes.
+        //! @param size Number of bytes.
+        //! @param count Number of copies.
+        void checksum_repeat(const uint8_t *bytes, int size, size_t count);
+        //! Write pending bytes of the deflate stream as an IDAT chunk.
+        void flush_chunk();
+        //! Write a chunk.
+        //! @param type Chunk type.
+        //! @param data Data.
+        //! @param n Data size.
+        void write_chunk(const char *type, const uint8_t *data, size_t n);
+
+        //! Output file (nullptr once closed or if it failed to open).
+        FILE *file_;
+        //! Whether a write failed.
+        bool failed_;
+        //! Image width and height.
+        int width_, height_;
+        //! Number of rows written.
+        int rows_;
+        //! Palette, or nullptr for RGB.
+        const Palette *palette_;
+        //! Bytes per pixel.
+        int pixel_bytes_;
+        //! Bit buffer and number of bits in it.
+        uint32_t bit_buffer_;
+        int bit_count_;
+        //! Adler-32 sums.
+        uint32_t adler_a_, adler_b_;
+        //! Deflate stream not yet written.
+        std::vector<uint8_t> pending_;
+        //! Runs of the previous row, and scratch runs.
+        std::vector<ColorRun> previous_, runs_;
+    };
+}
+#endif
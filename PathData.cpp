@@ -0,0 +1,642 @@
+//! @file PathData.cpp
+#include "PathData.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+namespace svg
+{
+    // Coordinates are clamped to this range when converted to pixels.
+    static const double COORD_LIMIT = 1 << 28;
+    // Curves are split at most this many times.
+    static const int MAX_DEPTH = 16;
+
+    FillRule parse_fill_rule(const std::string &str)
+    {
+        return str == "evenodd" ? FillRule::EvenOdd : FillRule::NonZero;
+    }
+
+    void PathData::move_to(const Vec2 &p)
+    {
+        verbs_.push_back(MoveTo);
+        points_.push_back(p);
+    }
+
+    void PathData::line_to(const Vec2 &p)
+    {
+        verbs_.push_back(LineTo);
+        points_.push_back(p);
+    }
+
+    void PathData::cubic_to(const Vec2 &c1, const Vec2 &c2, const Vec2 &p)
+    {
+        verbs_.push_back(CubicTo);
+        points_.push_back(c1);
+        points_.push_back(c2);
+        points_.push_back(p);
+    }
+
+    void PathData::close()
+    {
+        verbs_.push_back(Close);
+    }
+
+    bool PathData::empty() const
+    {
+        for (Verb verb : verbs_)
+        {
+            if (verb == LineTo || verb == CubicTo)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::vector<PathData::Verb> &PathData::verbs() const
+    {
+        return verbs_;
+    }
+
+    const std::vector<Vec2> &PathData::points() const
+    {
+        return points_;
+    }
+
+    void PathData::translate(const Vec2 &t)
+    {
+        for (Vec2 &p : points_)
+        {
+            p.x += t.x;
+            p.y += t.y;
+        }
+    }
+
+    void PathData::transform(const AffineTransform &t)
+    {
+        for (Vec2 &p : points_)
+        {
+            double dx = p.x - t.origin.x, dy = p.y - t.origin.y;
+            p.x = t.origin.x + t.a * dx + t.b * dy;
+            p.y = t.origin.y + t.c * dx + t.d * dy;
+        }
+    }
+
+    // Pixel coordinate at or below a real coordinate.
+    static int floor_pixel(double v)
+    {
+        return (int)std::floor(std::min(std::max(v, -COORD_LIMIT), COORD_LIMIT));
+    }
+
+    // Pixel coordinate at or above a real coordinate.
+    static int ceil_pixel(double v)
+    {
+        return (int)std::ceil(std::min(std::max(v, -COORD_LIMIT), COORD_LIMIT));
+    }
+
+    BoundingBox PathData::bounds() const
+    {
+        if (points_.empty())
+        {
+            return {{0, 0}, {-1, -1}};
+        }
+        Vec2 lo = points_[0], hi = points_[0];
+        for (const Vec2 &p : points_)
+        {
+            lo.x = std::min(lo.x, p.x);
+            lo.y = std::min(lo.y, p.y);
+            hi.x = std::max(hi.x, p.x);
+            hi.y = std::max(hi.y, p.y);
+        }
+        return {{floor_pixel(lo.x), floor_pixel(lo.y)}, {ceil_pixel(hi.x), ceil_pixel(hi.y)}};
+    }
+
+    // Append the end points of the pieces of a cubic curve, splitting it
+    // in halves until its control points are close enough to the chord.
+    // The test bounds the distance between curve and chord by
+    // sqrt(max(ux^2, vx^2) + max(uy^2, vy^2)) / 4.
+    static void flatten_cubic(const Vec2 &p0, const Vec2 &p1, const Vec2 &p2, const Vec2 &p3,
+                              double limit, int depth, std::vector<Vec2> &out)
+    {
+        double ux = 3 * p1.x - 2 * p0.x - p3.x, uy = 3 * p1.y - 2 * p0.y - p3.y;
+        double vx = 3 * p2.x - p0.x - 2 * p3.x, vy = 3 * p2.y - p0.y - 2 * p3.y;
+        double d = std::max(ux * ux, vx * vx) + std::max(uy * uy, vy * vy);
+        if (depth >= MAX_DEPTH || !(d > limit))
+        {
+            out.push_back(p3);
+            return;
+        }
+        Vec2 a{(p0.x + p1.x) / 2, (p0.y + p1.y) / 2};
+        Vec2 b{(p1.x + p2.x) / 2, (p1.y + p2.y) / 2};
+        Vec2 c{(p2.x + p3.x) / 2, (p2.y + p3.y) / 2};
+        Vec2 ab{(a.x + b.x) / 2, (a.y + b.y) / 2};
+        Vec2 bc{(b.x + c.x) / 2, (b.y + c.y) / 2};
+        Vec2 mid{(ab.x + bc.x) / 2, (ab.y + bc.y) / 2};
+        flatten_cubic(p0, a, ab, mid, limit, depth + 1, out);
+        flatten_cubic(mid, bc, c, p3, limit, depth + 1, out);
+    }
+
+    void PathData::flatten(double tolerance, std::vector<Contour> &contours) const
+    {
+        double limit = 16 * tolerance * tolerance;
+        Contour contour{{}, false};
+        // Close a subpath and start the next one.
+        auto finish = [&contours, &contour]()
+        {
+            if (contour.points.size() > 1)
+            {
+                contours.push_back(std::move(contour));
+            }
+            contour = Contour{{}, false};
+        };
+        size_t k = 0;
+        for (Verb verb : verbs_)
+        {
+            switch (verb)
+            {
+            case MoveTo:
+                finish();
+                contour.points.push_back(points_[k++]);
+                break;
+            case LineTo:
+                contour.points.push_back(points_[k++]);
+                break;
+            case CubicTo:
+                flatten_cubic(contour.points.back(), points_[k], points_[k + 1], points_[k + 2],
+                              limit, 0, contour.points);
+                k += 3;
+                break;
+            case Close:
+                contour.closed = true;
+                finish();
+                break;
+            }
+        }
+        finish();
+    }
+
+    size_t PathData::vertex_estimate(double tolerance) const
+    {
+        // Wang: n pieces with n^2 >= 3/4 * max |second difference| / tolerance.
+        size_t count = 0, k = 0;
+        for (Verb verb : verbs_)
+        {
+            if (verb == CubicTo)
+            {
+                const Vec2 &p0 = points_[k - 1], &p1 = points_[k], &p2 = points_[k + 1], &p3 = points_[k + 2];
+                double m = std::max(std::hypot(p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y),
+                                    std::hypot(p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y));
+                double n = std::ceil(std::sqrt(0.75 * m / tolerance));
+                count += (size_t)std::min(std::max(n, 1.0), (double)(1 << MAX_DEPTH));
+                k += 3;
+            }
+            else if (verb != Close)
+            {
+                count++;
+                k++;
+            }
+        }
+        return count;
+    }
+
+    ContourFill::ContourFill(const std::vector<Contour> &contours, FillRule rule)
+        : rule_(rule), next_(0), row_(INT_MIN), bounds_{{0, 0}, {-1, -1}}
+    {
+        Vec2 lo{COORD_LIMIT, COORD_LIMIT}, hi{-COORD_LIMIT, -COORD_LIMIT};
+        for (const Contour &contour : contours)
+        {
+            const std::vector<Vec2> &points = contour.points;
+            for (size_t i = 0; i < points.size(); i++)
+            {
+                Vec2 a = points[i], b = points[(i + 1) % points.size()];
+                lo.x = std::min(lo.x, a.x);
+                lo.y = std::min(lo.y, a.y);
+                hi.x = std::max(hi.x, a.x);
+                hi.y = std::max(hi.y, a.y);
+                if (a.y == b.y || !std::isfinite(a.x + a.y + b.x + b.y))
+                {
+                    continue;
+                }
+                int winding = 1;
+                if (a.y > b.y)
+                {
+                    std::swap(a, b);
+                    winding = -1;
+                }
+                double slope = (b.x - a.x) / (b.y - a.y);
+                edges_.push_back({a.y, b.y, a.x, slope, winding});
+            }
+        }
+        std::sort(edges_.begin(), edges_.end(),
+                  [](const Edge &a, const Edge &b)
+                  { return a.top < b.top; });
+        if (!edges_.empty())
+        {
+            // Rows are sampled at integer positions in [top, bottom).
+            bounds_ = {{floor_pixel(lo.x), ceil_pixel(lo.y)}, {ceil_pixel(hi.x), ceil_pixel(hi.y) - 1}};
+        }
+    }
+
+    BoundingBox ContourFill::bounds() const
+    {
+        return bounds_;
+    }
+
+    void ContourFill::row_spans(int y, std::vector<Point> &spans)
+    {
+        spans.clear();
+        if (y < row_)
+        {
+            active_.clear();
+            next_ = 0;
+        }
+        row_ = y;
+        size_t kept = 0;
+        for (size_t i : active_)
+        {
+            if (edges_[i].bottom > y)
+            {
+                active_[kept++] = i;
+            }
+        }
+        active_.resize(kept);
+        for (; next_ < edges_.size() && edges_[next_].top <= y; next_++)
+        {
+            if (edges_[next_].bottom > y)
+            {
+                active_.push_back(next_);
+            }
+        }
+
+        crossings_.clear();
+        for (size_t i : active_)
+        {
+            const Edge &e = edges_[i];
+            crossings_.push_back({e.x + (y - e.top) * e.slope, e.winding});
+        }
+        std::sort(crossings_.begin(), crossings_.end());
+        int winding = 0;
+        double start = 0;
+        for (const std::pair<double, int> &c : crossings_)
+        {
+            bool was_inside = rule_ == FillRule::EvenOdd ? (winding & 1) != 0 : winding != 0;
+            winding += c.second;
+            bool inside = rule_ == FillRule::EvenOdd ? (winding & 1) != 0 : winding != 0;
+            if (!was_inside && inside)
+            {
+                start = c.first;
+            }
+            else if (was_inside && !inside)
+            {
+                // Pixels x with start <= x < c.first.
+                int x0 = ceil_pixel(start), x1 = ceil_pixel(c.first) - 1;
+                if (x0 > x1)
+                {
+                    continue;
+                }
+                if (!spans.empty() && spans.back().y + 1 >= x0)
+                {
+                    spans.back().y = std::max(spans.back().y, x1);
+                }
+                else
+                {
+                    spans.push_back({x0, x1});
+                }
+            }
+        }
+    }
+
+    // Reader of the numbers and flags of path data.
+    struct PathScanner
+    {
+        const char *p;
+        const char *end;
+
+        // Skip whitespace.
+        void skip_space()
+        {
+            while (p < end && std::isspace((unsigned char)*p))
+            {
+                p++;
+            }
+        }
+
+        // Skip whitespace with at most one comma.
+        void skip_separator()
+        {
+            skip_space();
+            if (p < end && *p == ',')
+            {
+                p++;
+                skip_space();
+            }
+        }
+
+        // Check if a number starts here.
+        bool at_number() const
+        {
+            return p < end && (std::isdigit((unsigned char)*p) || *p == '-' || *p == '+' || *p == '.');
+        }
+
+        // Read a number followed by an optional separator. Numbers may
+        // follow each other without separator ("1-2", "0.5.5").
+        bool number(double &v)
+        {
+            const char *start = p;
+            if (p < end && (*p == '-' || *p == '+'))
+            {
+                p++;
+            }
+            const char *digits = p;
+            while (p < end && std::isdigit((unsigned char)*p))
+            {
+                p++;
+            }
+            if (p < end && *p == '.')
+            {
+                p++;
+                while (p < end && std::isdigit((unsigned char)*p))
+                {
+                    p++;
+                }
+            }
+            if (p == digits || (p == digits + 1 && *digits == '.'))
+            {
+                p = start;
+                return false;
+            }
+            if (p < end && (*p == 'e' || *p == 'E'))
+            {
+                const char *e = p + 1;
+                if (e < end && (*e == '-' || *e == '+'))
+                {
+                    e++;
+                }
+                if (e < end && std::isdigit((unsigned char)*e))
+                {
+                    p = e;
+                    while (p < end && std::isdigit((unsigned char)*p))
+                    {
+                        p++;
+                    }
+                }
+            }
+            v = std::strtod(std::string(start, p).c_str(), nullptr);
+            if (!std::isfinite(v))
+            {
+                p = start;
+                return false;
+            }
+            skip_separator();
+            return true;
+        }
+
+        // Read an arc flag ('0' or '1', possibly not followed by a separator).
+        bool flag(bool &f)
+        {
+            if (p >= end || (*p != '0' && *p != '1'))
+            {
+                return false;
+            }
+            f = *p++ == '1';
+            skip_separator();
+            return true;
+        }
+
+        // Read a pair of numbers.
+        bool point(Vec2 &v)
+        {
+            return number(v.x) && number(v.y);
+        }
+    };
+
+    // Append an elliptical arc as cubic curves of at most 90 degrees
+    // (SVG implementation notes, conversion from endpoint to center
+    // parameterization).
+    static void arc_to(PathData &path, const Vec2 &p0, double rx, double ry, double angle,
+                       bool large_arc, bool sweep, const Vec2 &p)
+    {
+        if (p0.x == p.x && p0.y == p.y)
+        {
+            return;
+        }
+        rx = std::fabs(rx);
+        ry = std::fabs(ry);
+        if (rx == 0 || ry == 0)
+        {
+            path.line_to(p);
+            return;
+        }
+        double phi = angle * M_PI / 180, c = std::cos(phi), s = std::sin(phi);
+        double hx = (p0.x - p.x) / 2, hy = (p0.y - p.y) / 2;
+        double x1 = c * hx + s * hy, y1 = -s * hx + c * hy;
+        // Radii too small to join the end points are scaled up.
+        double lambda = x1 * x1 / (rx * rx) + y1 * y1 / (ry * ry);
+        if (lambda > 1)
+        {
+            rx *= std::sqrt(lambda);
+            ry *= std::sqrt(lambda);
+        }
+        double num = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+        double den = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+        double coef = std::sqrt(std::max(0.0, num / den));
+        if (large_arc == sweep)
+        {
+            coef = -coef;
+        }
+        double cx1 = coef * rx * y1 / ry, cy1 = -coef * ry * x1 / rx;
+        double cx = c * cx1 - s * cy1 + (p0.x + p.x) / 2;
+        double cy = s * cx1 + c * cy1 + (p0.y + p.y) / 2;
+        double theta = std::atan2((y1 - cy1) / ry, (x1 - cx1) / rx);
+        double delta = std::atan2((-y1 - cy1) / ry, (-x1 - cx1) / rx) - theta;
+        if (!sweep && delta > 0)
+        {
+            delta -= 2 * M_PI;
+        }
+        else if (sweep && delta < 0)
+        {
+            delta += 2 * M_PI;
+        }
+
+        int n = std::max(1, (int)std::ceil(std::fabs(delta) / (M_PI / 2) - 1e-9));
+        double step = delta / n, k = 4.0 / 3 * std::tan(step / 4);
+        // Point and derivative of the ellipse at an angle.
+        auto at = [&](double t, Vec2 &q, Vec2 &dq)
+        {
+            double ct = std::cos(t), st = std::sin(t);
+            q = {cx + rx * ct * c - ry * st * s, cy + rx * ct * s + ry * st * c};
+            dq = {-rx * st * c - ry * ct * s, -rx * st * s + ry * ct * c};
+        };
+        Vec2 a, da, b, db;
+        at(theta, a, da);
+        for (int i = 0; i < n; i++)
+        {
+            at(theta + (i + 1) * step, b, db);
+            if (i == n - 1)
+            {
+                b = p;
+            }
+            path.cubic_to({a.x + k * da.x, a.y + k * da.y}, {b.x - k * db.x, b.y - k * db.y}, b);
+            a = b;
+            da = db;
+        }
+    }
+
+    bool parse_path_data(const std::string &d, PathData &path)
+    {
+        PathScanner in{d.data(), d.data() + d.size()};
+        Vec2 current{0, 0}, start{0, 0};
+        // Last control point of the previous command, for S and T.
+        Vec2 control{0, 0};
+        char previous = 0;
+        bool open = false;
+        in.skip_space();
+        while (in.p < in.end)
+        {
+            char command = *in.p++;
+            char upper = (char)std::toupper((unsigned char)command);
+            bool relative = command != upper;
+            if (previous == 0 && upper != 'M')
+            {
+                return false;
+            }
+            in.skip_space();
+            if (upper == 'Z')
+            {
+                path.close();
+                current = start;
+                open = false;
+                previous = upper;
+                continue;
+            }
+            if (!in.at_number())
+            {
+                return false;
+            }
+            // Arguments repeat the command until the next letter.
+            while (in.at_number())
+            {
+                Vec2 origin = relative ? current : Vec2{0, 0};
+                Vec2 c1{0, 0}, c2{0, 0}, p{0, 0};
+                double rx = 0, ry = 0, angle = 0;
+                bool large_arc = false, sweep = false;
+                if (upper != 'M' && !open)
+                {
+                    // Drawing after Z starts a subpath at the closed one's start.
+                    path.move_to(current);
+                    open = true;
+                }
+                switch (upper)
+                {
+                case 'M':
+                    if (!in.point(p))
+                    {
+                        return false;
+                    }
+                    current = start = {origin.x + p.x, origin.y + p.y};
+                    path.move_to(current);
+                    open = true;
+                    // Further pairs are lines.
+                    upper = 'L';
+                    break;
+                case 'L':
+                    if (!in.point(p))
+                    {
+                        return false;
+                    }
+                    current = {origin.x + p.x, origin.y + p.y};
+                    path.line_to(current);
+                    break;
+                case 'H':
+                    if (!in.number(p.x))
+                    {
+                        return false;
+                    }
+                    current.x = origin.x + p.x;
+                    path.line_to(current);
+                    break;
+                case 'V':
+                    if (!in.number(p.y))
+                    {
+                        return false;
+                    }
+                    current.y = origin.y + p.y;
+                    path.line_to(current);
+                    break;
+                case 'C':
+                case 'S':
+                    if (upper == 'C')
+                    {
+                        if (!in.point(c1))
+                        {
+                            return false;
+                        }
+                        c1 = {origin.x + c1.x, origin.y + c1.y};
+                    }
+                    else
+                    {
+                        c1 = previous == 'C' || previous == 'S'
+                                 ? Vec2{2 * current.x - control.x, 2 * current.y - control.y}
+                                 : current;
+                    }
+                    if (!in.point(c2) || !in.point(p))
+                    {
+                        return false;
+                    }
+                    c2 = {origin.x + c2.x, origin.y + c2.y};
+                    p = {origin.x + p.x, origin.y + p.y};
+                    path.cubic_to(c1, c2, p);
+                    control = c2;
+                    current = p;
+                    break;
+                case 'Q':
+                case 'T':
+                    // The quadratic control point q gives the cubic
+                    // control points start + 2/3 (q - start) and
+                    // end + 2/3 (q - end).
+                    if (upper == 'Q')
+                    {
+                        if (!in.point(c1))
+                        {
+                            return false;
+                        }
+                        c1 = {origin.x + c1.x, origin.y + c1.y};
+                    }
+                    else
+                    {
+                        c1 = previous == 'Q' || previous == 'T'
+                                 ? Vec2{2 * current.x - control.x, 2 * current.y - control.y}
+                                 : current;
+                    }
+                    if (!in.point(p))
+                    {
+                        return false;
+                    }
+                    p = {origin.x + p.x, origin.y + p.y};
+                    path.cubic_to({current.x + 2.0 / 3 * (c1.x - current.x), current.y + 2.0 / 3 * (c1.y - current.y)},
+                                  {p.x + 2.0 / 3 * (c1.x - p.x), p.y + 2.0 / 3 * (c1.y - p.y)}, p);
+                    control = c1;
+                    current = p;
+                    break;
+                case 'A':
+                    if (!in.number(rx) || !in.number(ry) || !in.number(angle) ||
+                        !in.flag(large_arc) || !in.flag(sweep) || !in.point(p))
+                    {
+                        return false;
+                    }
+                    p = {origin.x + p.x, origin.y + p.y};
+                    arc_to(path, current, rx, ry, angle, large_arc, sweep, p);
+                    current = p;
+                    break;
+                default:
+                    return false;
+                }
+                previous = upper;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,183 @@
+//! @file PathData.hpp
+#ifndef __svg_PathData_hpp__
+#define __svg_PathData_hpp__
+
+#include "Point.hpp"
+#include "PointBatch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace svg
+{
+    //! Point with real coordinates.
+    struct Vec2
+    {
+        //! X coordinate.
+        double x;
+        //! Y coordinate.
+        double y;
+    };
+
+    //! Rule deciding which points are inside a set of contours.
+    enum class FillRule
+    {
+        //! Inside if the contours wind around the point a non-zero
+        //! number of times.
+        NonZero,
+        //! Inside if a ray from the point crosses the contours an odd
+        //! number of times.
+        EvenOdd
+    };
+
+    //! Parse a fill-rule value ("nonzero" or "evenodd").
+    //! @param str String.
+    //! @return The rule (NonZero for unknown values).
+    FillRule parse_fill_rule(const std::string &str);
+
+    //! Polyline approximating a subpath.
+    struct Contour
+    {
+        //! Vertices.
+        std::vector<Vec2> points;
+        //! The subpath was closed (Z), so its stroke joins the last
+        //! vertex to the first.
+        bool closed;
+    };
+
+    //! Geometry of a <path>: subpaths of straight lines and cubic
+    //! Bézier curves in real coordinates. Quadratic curves and arcs are
+    //! converted to cubics when parsed, so every transform keeps the
+    //! curves exact; they are flattened to polylines only when drawn.
+    class PathData
+    {
+    public:
+        //! Path commands.
+        enum Verb : uint8_t
+        {
+            //! Start a subpath at one point.
+            MoveTo,
+            //! Line to one point.
+            LineTo,
+            //! Cubic curve through two control points to one point.
+            CubicTo,
+            //! Close the current subpath (no points).
+            Close
+        };
+
+        //! Start a subpath. Lines and curves must follow a subpath start.
+        //! @param p Start point.
+        void move_to(const Vec2 &p);
+        //! Add a line to the current subpath.
+        //! @param p End point.
+        void line_to(const Vec2 &p);
+        //! Add a cubic curve to the current subpath.
+        //! @param c1 First control point.
+        //! @param c2 Second control point.
+        //! @param p End point.
+        void cubic_to(const Vec2 &c1, const Vec2 &c2, const Vec2 &p);
+        //! Close the current subpath.
+        void close();
+        //! Check if the path has no drawable segment.
+        //! @return true if there are no lines or curves.
+        bool empty() const;
+        //! Get the commands.
+        //! @return The commands, in order.
+        const std::vector<Verb> &verbs() const;
+        //! Get the points of the commands.
+        //! @return The points, in order.
+        const std::vector<Vec2> &points() const;
+
+        //! Translate all points.
+        //! @param t Translation vector.
+        void translate(const Vec2 &t);
+        //! Apply an affine transform to all points, without rounding.
+        //! @param t The transform.
+        void transform(const AffineTransform &t);
+        //! Get the box around the points and control points, which
+        //! contains the whole path.
+        //! @return Box of the pixels the fill may cover (empty if the
+        //!         path has no points).
+        BoundingBox bounds() const;
+        //! Approximate the subpaths with polylines. Curves are split
+        //! recursively until each piece is within a distance of its
+        //! chord, so the number of vertices follows the drawn size.
+        //! @param tolerance Maximum distance, in pixels, between a curve
+        //!        and its polyline.
+        //! @param contours Output polylines, one per subpath with at
+        //!        least one segment.
+        void flatten(double tolerance, std::vector<Contour> &contours) const;
+        //! Estimate the number of vertices produced by flatten(), from
+        //! the bound of Wang's formula on the pieces each curve needs.
+        //! @param tolerance Tolerance, as for flatten().
+        //! @return Number of vertices.
+        size_t vertex_estimate(double tolerance) const;
+
+    private:
+        //! Commands.
+        std::vector<Verb> verbs_;
+        //! Points of the commands (1 for MoveTo and LineTo, 3 for CubicTo).
+        std::vector<Vec2> points_;
+    };
+
+    //! Area enclosed by contours under a fill rule, scanned row by row.
+    //! Each contour is implicitly closed. Pixel (x, y) is covered if the
+    //! point (x, y) is inside; points on a left or top edge are inside,
+    //! on a right or bottom edge outside, so paths sharing an edge do
+    //! not both cover the pixels along it.
+    class ContourFill
+    {
+    public:
+        //! Constructor.
+        //! @param contours Contours.
+        //! @param rule Fill rule.
+        ContourFill(const std::vector<Contour> &contours, FillRule rule);
+        //! Get the pixels that may be covered.
+        //! @return Box of covered pixels (may be slightly larger).
+        BoundingBox bounds() const;
+        //! Compute the covered spans of a row. Fastest when called for
+        //! increasing rows.
+        //! @param y Y position.
+        //! @param spans Output spans, each given as a point (first X, last X),
+        //!              sorted and disjoint.
+        void row_spans(int y, std::vector<Point> &spans);
+
+    private:
+        //! Non-horizontal contour edge, covering rows top <= y < bottom.
+        struct Edge
+        {
+            //! Y extent.
+            double top, bottom;
+            //! X position at top, and change of X per row.
+            double x, slope;
+            //! +1 for downward edges, -1 for upward ones.
+            int winding;
+        };
+
+        //! Fill rule.
+        FillRule rule_;
+        //! Edges, sorted by top.
+        std::vector<Edge> edges_;
+        //! Indices of edges that may cross the current row.
+        std::vector<size_t> active_;
+        //! Next edge to activate.
+        size_t next_;
+        //! Last row passed to row_spans.
+        int row_;
+        //! Box of covered pixels.
+        BoundingBox bounds_;
+        //! Scratch crossings (X position, winding).
+        std::vector<std::pair<double, int>> crossings_;
+    };
+
+    //! Parse the d attribute of a <path> (commands M, L, H, V, C, S, Q,
+    //! T, A and Z, absolute and relative). As required by SVG, parsing
+    //! stops at the first error and the path up to it is kept.
+    //! @param d Path data string.
+    //! @param path Path to append to.
+    //! @return true if the whole string was parsed.
+    bool parse_path_data(const std::string &d, PathData &path);
+}
+#endif
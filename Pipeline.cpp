@@ -0,0 +1,125 @@
+#include "Pipeline.hpp"
+#include "FramebufferPool.hpp"
+#include <exception>
+#include <thread>
+
+using namespace std;
+
+namespace svg
+{
+    // Implementation for PipelineOptions
+    PipelineOptions::PipelineOptions() : max_in_flight(2), parse_ahead(1), job_timeout(0) {}
+
+    // A job moving through the pipeline
+    struct PipelineItem {
+        size_t job; ///< Index of the job.
+        unique_ptr<CancellationToken> cancel; ///< The job's token, following options.render.cancel and the job's deadline.
+        unique_ptr<Scene> scene; ///< The parsed document, until it is drawn.
+        unique_ptr<PNGImage> img; ///< The drawn image, until it is saved.
+        vector<Color> palette; ///< The colors of the image, if known from the scene.
+    };
+
+    // Counting semaphore limiting the framebuffers in flight
+    class FramebufferSlots {
+    public:
+        explicit FramebufferSlots(size_t count) : available(count < 1 ? 1 : count) {}
+        void acquire() {
+            unique_lock<mutex> lock(m);
+            freed.wait(lock, [this] { return available > 0; });
+            available--;
+        }
+        void release() {
+            lock_guard<mutex> lock(m);
+            available++;
+            freed.notify_one();
+        }
+    private:
+        size_t available;
+        mutex m;
+        condition_variable freed;
+    };
+
+    vector<ConversionResult> convert_all(const vector<ConversionJob>& jobs, const PipelineOptions& options) {
+        vector<ConversionResult> results(jobs.size(), ConversionResult{false, ""});
+        BoundedQueue<PipelineItem> parsed(options.parse_ahead);
+        BoundedQueue<PipelineItem> drawn(options.max_in_flight);
+        FramebufferSlots slots(options.max_in_flight);
+        FramebufferPool& pool = FramebufferPool::shared();
+
+        // Each job's result is written by one stage only, so no locking is needed.
+        thread parser([&] {
+            for (size_t i = 0; i < jobs.size(); i++) {
+                PipelineItem item;
+                item.job = i;
+                item.cancel = make_unique<CancellationToken>(options.render.cancel);
+                if (options.job_timeout.count() > 0) {
+                    item.cancel->set_timeout(options.job_timeout);
+                }
+                try {
+                    item.scene = make_unique<Scene>(jobs[i].svg_file, item.cancel.get(), options.render.parse_threads);
+                    item.scene->admit(options.render.budget);
+                } catch (const exception& e) {
+                    results[i].error = e.what();
+                    item.scene.reset();
+                }
+                parsed.push(move(item));
+            }
+            parsed.close();
+        });
+        thread rasterizer([&] {
+            PipelineItem item;
+            while (parsed.pop(item)) {
+                if (item.scene) {
+                    const Point& dims = item.scene->dimensions();
+                    slots.acquire();
+                    try {
+                        if (options.render.storage == PixelStorage::Dense) {
+                            item.img = make_unique<PNGImage>(pool.acquire(dims.x, dims.y));
+                        } else {
+                            item.img = make_unique<PNGImage>(dims.x, dims.y, options.render.storage);
+                        }
+                        RenderOptions render = options.render;
+                        render.cancel = item.cancel.get();
+                        item.scene->draw(*item.img, render);
+                        if (options.render.indexed_png) {
+                            item.scene->palette(item.palette);
+                        }
+                    } catch (const exception& e) {
+                        results[item.job].error = e.what();
+                        if (item.img) {
+                            pool.release(move(*item.img));
+                            item.img.reset();
+                        }
+                        slots.release();
+                    }
+                    item.scene.reset();
+                }
+                drawn.push(move(item));
+            }
+            drawn.close();
+        });
+
+        PipelineItem item;
+        while (drawn.pop(item)) {
+            if (!item.img) {
+                continue;
+            }
+            try {
+                if (options.render.indexed_png) {
+                    item.img->save_indexed(jobs[item.job].png_file, item.palette);
+                } else {
+                    item.img->save(jobs[item.job].png_file);
+                }
+                results[item.job].ok = true; // Saving throws on failure
+            } catch (const exception& e) {
+                results[item.job].error = e.what();
+            }
+            pool.release(move(*item.img));
+            item.img.reset();
+            slots.release();
+        }
+        parser.join();
+        rasterizer.join();
+        return results;
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef __svg_Pipeline_hpp__
+#define __svg_Pipeline_hpp__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Scene.hpp"
+
+namespace svg
+{
+    /**
+     * @brief Fixed-capacity queue for handing work between threads.
+     */
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        /**
+         * @brief Constructs an empty queue.
+         * @param capacity The maximum number of queued items (at least 1).
+         */
+        explicit BoundedQueue(size_t capacity) : capacity(capacity < 1 ? 1 : capacity), closed(false) {}
+
+        /**
+         * @brief Adds an item, waiting while the queue is full.
+         * @param item The item.
+         */
+        void push(T &&item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this] { return items.size() < capacity; });
+            items.push_back(std::move(item));
+            not_empty.notify_one();
+        }
+        /**
+         * @brief Removes the oldest item, waiting while the queue is empty and open.
+         * @param item The variable to store the item.
+         * @return false if the queue is closed and empty.
+         */
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this] { return !items.empty() || closed; });
+            if (items.empty()) {
+                return false;
+            }
+            item = std::move(items.front());
+            items.pop_front();
+            not_full.notify_one();
+            return true;
+        }
+        /**
+         * @brief Marks the end of the input; pop() fails once the queue drains.
+         */
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            not_empty.notify_all();
+        }
+
+    private:
+        size_t capacity; ///< The maximum number of queued items.
+        bool closed; ///< Whether close() was called.
+        std::deque<T> items; ///< The queued items.
+        std::mutex mutex; ///< Protects the members above.
+        std::condition_variable not_full; ///< Signaled when an item is removed.
+        std::condition_variable not_empty; ///< Signaled when an item is added or the queue is closed.
+    };
+
+    /**
+     * @brief An SVG file to convert and the PNG file to write.
+     */
+    struct ConversionJob
+    {
+        std::string svg_file; ///< The path to the SVG file.
+        std::string png_file; ///< The path to the PNG file.
+    };
+
+    /**
+     * @brief The outcome of a conversion job.
+     */
+    struct ConversionResult
+    {
+        bool ok; ///< Whether the PNG file was written.
+        std::string error; ///< The error message if the conversion failed.
+    };
+
+    /**
+     * @brief Options for converting many files.
+     */
+    struct PipelineOptions
+    {
+        PipelineOptions(); ///< Constructor of default options.
+        size_t max_in_flight; ///< The maximum number of framebuffers allocated at once (default 2).
+        size_t parse_ahead; ///< The maximum number of parsed scenes waiting to be drawn (default 1).
+        std::chrono::milliseconds job_timeout; ///< The time each job may take to parse and draw, from its start (default 0, no limit).
+        RenderOptions render; ///< The rendering options (render.cancel, if set, applies to every job).
+    };
+
+    /**
+     * @brief Converts SVG files to PNG files with a three-stage pipeline.
+     *
+     * One thread parses, one draws and one encodes, so file N+1 is parsed while
+     * file N is drawn and file N-1 is saved. The stages are connected by
+     * bounded queues, and drawing waits while max_in_flight framebuffers are
+     * still being encoded. A failing job does not stop the others, and a job
+     * running past job_timeout fails alone: its deadline starts when it is parsed.
+     * @param jobs The files to convert.
+     * @param options The pipeline options.
+     * @return The outcome of each job, in the order of jobs.
+     */
+    std::vector<ConversionResult> convert_all(const std::vector<ConversionJob> &jobs,
+                                              const PipelineOptions &options = PipelineOptions());
+}
+
+#endif
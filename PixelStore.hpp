@@ -0,0 +1,70 @@
+//! @file PixelStore.hpp
+#ifndef __svg_PixelStore_hpp__
+#define __svg_PixelStore_hpp__
+
+#include "Color.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace svg
+{
+    //! Pixels of one color, from X position x to the start of the next
+    //! run of the row (or the end of the row).
+    struct ColorRun
+    {
+        //! X position of the first pixel.
+        int x;
+        //! Color.
+        Color color;
+    };
+
+    //! Pixel storage of a PNGImage other than its dense buffer, written
+    //! and read a row span at a time. Pixels start white.
+    class PixelStore
+    {
+    public:
+        //! Destructor.
+        virtual ~PixelStore() {}
+        //! Set all pixels to white.
+        virtual void clear() = 0;
+        //! Fill a span of a row, over what it covers.
+        //! @param y Y position.
+        //! @param x0 First X position (in the row).
+        //! @param x1 Last X position (in the row, at least x0).
+        //! @param c Color.
+        virtual void fill(int y, int x0, int x1, const Color &c) = 0;
+        //! Set consecutive pixels of a row.
+        //! @param y Y position.
+        //! @param x0 First X position (in the row).
+        //! @param n Number of pixels (x0 + n at most the width).
+        //! @param colors Colors.
+        virtual void set_pixels(int y, int x0, int n, const Color *colors) = 0;
+        //! Get a pixel.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Color.
+        virtual Color get(int x, int y) const = 0;
+        //! Expand part of a row to pixels.
+        //! @param y Y position.
+        //! @param x0 First X position.
+        //! @param n Number of pixels.
+        //! @param out Output pixels.
+        virtual void expand(int y, int x0, int n, Color *out) const = 0;
+        //! Get a row as runs, for encoding (see PNGStreamWriter).
+        //! @param y Y position.
+        //! @param out Output runs, the first at X 0, no two consecutive
+        //!        runs of the same color.
+        virtual void row_runs(int y, std::vector<ColorRun> &out) const = 0;
+        //! Get the memory held by the pixels.
+        //! @return Size in bytes.
+        virtual size_t memory() const = 0;
+        //! Get the address of a pixel, for storages holding one color
+        //! per pixel.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Pointer to the pixel, or nullptr if not addressable.
+        virtual Color *address(int x, int y) { return nullptr; }
+    };
+}
+#endif
@@ -1,5 +1,6 @@
 //! @file point.cpp
 #include <cmath>
+#include <algorithm>
 #include "Point.hpp"
 
 namespace svg
@@ -27,4 +28,51 @@ namespace svg
                 origin.y + (y - origin.y) * v};
     }
 
+    bool BoundingBox::empty() const
+    {
+        return min.x > max.x || min.y > max.y;
+    }
+
+    bool BoundingBox::intersects(const BoundingBox &other) const
+    {
+        return !intersection(other).empty();
+    }
+
+    BoundingBox BoundingBox::intersection(const BoundingBox &other) const
+    {
+        return {{std::max(min.x, other.min.x), std::max(min.y, other.min.y)},
+                {std::min(max.x, other.max.x), std::min(max.y, other.max.y)}};
+    }
+
+    BoundingBox BoundingBox::merge(const BoundingBox &other) const
+    {
+        if (empty())
+        {
+            return other;
+        }
+        if (other.empty())
+        {
+            return *this;
+        }
+        return {{std::min(min.x, other.min.x), std::min(min.y, other.min.y)},
+                {std::max(max.x, other.max.x), std::max(max.y, other.max.y)}};
+    }
+
+    BoundingBox BoundingBox::around(const Point *points, size_t n)
+    {
+        if (n == 0)
+        {
+            return {{0, 0}, {-1, -1}};
+        }
+        BoundingBox box = {points[0], points[0]};
+        for (size_t i = 1; i < n; i++)
+        {
+            box.min.x = std::min(box.min.x, points[i].x);
+            box.min.y = std::min(box.min.y, points[i].y);
+            box.max.x = std::max(box.max.x, points[i].x);
+            box.max.y = std::max(box.max.y, points[i].y);
+        }
+        return box;
+    }
+
 }
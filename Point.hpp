@@ -2,6 +2,8 @@
 #ifndef __svg_point_hpp__
 #define __svg_point_hpp__
 
+#include <cstddef>
+
 namespace svg
 {
     //! 2D Point struct, with a few convenience member functions (can be defined for structs too).
@@ -27,5 +29,36 @@ namespace svg
         //! @return Scaling result.
         Point scale(const Point &origin, int v) const;
     };
+
+    //! Axis-aligned box of pixels; both corners are inclusive.
+    //! A box with min.x > max.x or min.y > max.y is empty.
+    struct BoundingBox
+    {
+        //! Top-left corner.
+        Point min;
+        //! Bottom-right corner.
+        Point max;
+
+        //! Check if the box is empty.
+        //! @return true if no pixel lies in the box.
+        bool empty() const;
+        //! Check if two boxes share at least one pixel.
+        //! @param other Other box.
+        //! @return true if the boxes intersect.
+        bool intersects(const BoundingBox &other) const;
+        //! Intersect two boxes.
+        //! @param other Other box.
+        //! @return Intersection (possibly empty).
+        BoundingBox intersection(const BoundingBox &other) const;
+        //! Smallest box containing both boxes.
+        //! @param other Other box.
+        //! @return Union.
+        BoundingBox merge(const BoundingBox &other) const;
+        //! Smallest box containing a set of points.
+        //! @param points Points.
+        //! @param n Number of points.
+        //! @return The box (empty if n is 0).
+        static BoundingBox around(const Point *points, size_t n);
+    };
 }
 #endif
@@ -0,0 +1,163 @@
+//! @file PointBatch.cpp
+#include "PointBatch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace svg
+{
+    AffineTransform AffineTransform::rotation(const Point &origin, int degrees)
+    {
+        // Same expressions as Point::rotate, so results are bit-identical.
+        double angle = M_PI * degrees / 180.0;
+        double s = ::sin(angle);
+        double c = ::cos(angle);
+        return {c, -s, s, c, origin};
+    }
+
+    void transform_points(int *xs, int *ys, size_t n, const AffineTransform &t)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128d a = _mm_set1_pd(t.a), b = _mm_set1_pd(t.b),
+                      c = _mm_set1_pd(t.c), d = _mm_set1_pd(t.d);
+        const __m128d ox = _mm_set1_pd(t.origin.x), oy = _mm_set1_pd(t.origin.y);
+        const __m128d half = _mm_set1_pd(0.5), neg_half = _mm_set1_pd(-0.5);
+        const __m128i oxi = _mm_set1_epi32(t.origin.x), oyi = _mm_set1_epi32(t.origin.y);
+        for (; i + 2 <= n; i += 2)
+        {
+            __m128d dx = _mm_sub_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)(xs + i))), ox);
+            __m128d dy = _mm_sub_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)(ys + i))), oy);
+            __m128d v[2] = {_mm_add_pd(_mm_mul_pd(a, dx), _mm_mul_pd(b, dy)),
+                            _mm_add_pd(_mm_mul_pd(c, dx), _mm_mul_pd(d, dy))};
+            __m128i r[2];
+            for (int k = 0; k < 2; k++)
+            {
+                // lround: truncate, then step away from zero when the
+                // (exact) fractional part is at least one half.
+                __m128i tr = _mm_cvttpd_epi32(v[k]);
+                __m128d frac = _mm_sub_pd(v[k], _mm_cvtepi32_pd(tr));
+                __m128i up = _mm_shuffle_epi32(_mm_castpd_si128(_mm_cmpge_pd(frac, half)), _MM_SHUFFLE(2, 0, 2, 0));
+                __m128i down = _mm_shuffle_epi32(_mm_castpd_si128(_mm_cmple_pd(frac, neg_half)), _MM_SHUFFLE(2, 0, 2, 0));
+                r[k] = _mm_add_epi32(_mm_sub_epi32(tr, up), down);
+            }
+            _mm_storel_epi64((__m128i *)(xs + i), _mm_add_epi32(r[0], oxi));
+            _mm_storel_epi64((__m128i *)(ys + i), _mm_add_epi32(r[1], oyi));
+        }
+#elif defined(__aarch64__)
+        const float64x2_t ox = vdupq_n_f64(t.origin.x), oy = vdupq_n_f64(t.origin.y);
+        const int32x2_t oxi = vdup_n_s32(t.origin.x), oyi = vdup_n_s32(t.origin.y);
+        for (; i + 2 <= n; i += 2)
+        {
+            float64x2_t dx = vsubq_f64(vcvtq_f64_s64(vmovl_s32(vld1_s32(xs + i))), ox);
+            float64x2_t dy = vsubq_f64(vcvtq_f64_s64(vmovl_s32(vld1_s32(ys + i))), oy);
+            float64x2_t vx = vaddq_f64(vmulq_n_f64(dx, t.a), vmulq_n_f64(dy, t.b));
+            float64x2_t vy = vaddq_f64(vmulq_n_f64(dx, t.c), vmulq_n_f64(dy, t.d));
+            // vcvta rounds to nearest with ties away from zero, like lround.
+            vst1_s32(xs + i, vadd_s32(vmovn_s64(vcvtaq_s64_f64(vx)), oxi));
+            vst1_s32(ys + i, vadd_s32(vmovn_s64(vcvtaq_s64_f64(vy)), oyi));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            double dx = xs[i] - t.origin.x;
+            double dy = ys[i] - t.origin.y;
+            xs[i] = t.origin.x + (int)::lround(t.a * dx + t.b * dy);
+            ys[i] = t.origin.y + (int)::lround(t.c * dx + t.d * dy);
+        }
+    }
+
+    PointBatch::PointBatch() {}
+
+    PointBatch::PointBatch(const std::vector<Point> &points)
+    {
+        xs_.reserve(points.size());
+        ys_.reserve(points.size());
+        for (const Point &p : points)
+        {
+            push_back(p);
+        }
+    }
+
+    size_t PointBatch::size() const
+    {
+        return xs_.size();
+    }
+
+    bool PointBatch::empty() const
+    {
+        return xs_.empty();
+    }
+
+    Point PointBatch::operator[](size_t i) const
+    {
+        return {xs_[i], ys_[i]};
+    }
+
+    void PointBatch::push_back(const Point &p)
+    {
+        xs_.push_back(p.x);
+        ys_.push_back(p.y);
+    }
+
+    BoundingBox PointBatch::bounds() const
+    {
+        if (empty())
+        {
+            return {{0, 0}, {-1, -1}};
+        }
+        BoundingBox box = {{xs_[0], ys_[0]}, {xs_[0], ys_[0]}};
+        for (size_t i = 1; i < xs_.size(); i++)
+        {
+            box.min.x = std::min(box.min.x, xs_[i]);
+            box.max.x = std::max(box.max.x, xs_[i]);
+            box.min.y = std::min(box.min.y, ys_[i]);
+            box.max.y = std::max(box.max.y, ys_[i]);
+        }
+        return box;
+    }
+
+    std::vector<Point> PointBatch::to_vector() const
+    {
+        std::vector<Point> points(size());
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            points[i] = {xs_[i], ys_[i]};
+        }
+        return points;
+    }
+
+    void PointBatch::translate(const Point &t)
+    {
+        for (size_t i = 0; i < xs_.size(); i++)
+        {
+            xs_[i] += t.x;
+            ys_[i] += t.y;
+        }
+    }
+
+    void PointBatch::scale(const Point &origin, int v)
+    {
+        for (size_t i = 0; i < xs_.size(); i++)
+        {
+            xs_[i] = origin.x + (xs_[i] - origin.x) * v;
+            ys_[i] = origin.y + (ys_[i] - origin.y) * v;
+        }
+    }
+
+    void PointBatch::rotate(const Point &origin, int degrees)
+    {
+        transform(AffineTransform::rotation(origin, degrees));
+    }
+
+    void PointBatch::transform(const AffineTransform &t)
+    {
+        transform_points(xs_.data(), ys_.data(), size(), t);
+    }
+}
@@ -0,0 +1,89 @@
+//! @file PointBatch.hpp
+#ifndef __svg_PointBatch_hpp__
+#define __svg_PointBatch_hpp__
+
+#include "Point.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace svg
+{
+    //! Affine transform about an origin, mapping (x, y) to
+    //! origin + round(M * ((x, y) - origin)), where M is the 2x2 matrix
+    //! [a b; c d] and rounding is half away from zero (as in ::lround).
+    struct AffineTransform
+    {
+        //! Matrix coefficients.
+        double a, b, c, d;
+        //! Transform origin.
+        Point origin;
+
+        //! Rotation matching Point::rotate.
+        //! @param origin Rotation origin.
+        //! @param degrees Degrees of rotation.
+        //! @return The transform.
+        static AffineTransform rotation(const Point &origin, int degrees);
+    };
+
+    //! Apply an affine transform to vertices stored as separate
+    //! X and Y arrays. Uses SSE2/NEON when available; results are
+    //! identical to transforming each point with Point::rotate.
+    //! @param xs X coordinates.
+    //! @param ys Y coordinates.
+    //! @param n Number of vertices.
+    //! @param t The transform.
+    void transform_points(int *xs, int *ys, size_t n, const AffineTransform &t);
+
+    //! Vertices stored as a structure of arrays, so that transforms
+    //! run over contiguous X and Y coordinates.
+    class PointBatch
+    {
+    public:
+        //! Constructor of empty batch.
+        PointBatch();
+        //! Constructor from points.
+        //! @param points Points to store.
+        PointBatch(const std::vector<Point> &points);
+        //! Get number of vertices.
+        //! @return The number of vertices.
+        size_t size() const;
+        //! Check if there are no vertices.
+        //! @return true if empty.
+        bool empty() const;
+        //! Get vertex.
+        //! @param i Vertex index.
+        //! @return The vertex.
+        Point operator[](size_t i) const;
+        //! Append a vertex.
+        //! @param p Vertex.
+        void push_back(const Point &p);
+        //! Get bounding box of the vertices.
+        //! @return The bounding box (empty if there are no vertices).
+        BoundingBox bounds() const;
+        //! Get vertices as points.
+        //! @return Vector of points.
+        std::vector<Point> to_vector() const;
+        //! Translate all vertices.
+        //! @param t translation direction.
+        void translate(const Point &t);
+        //! Scale all vertices.
+        //! @param origin Scaling origin.
+        //! @param v Scale amount.
+        void scale(const Point &origin, int v);
+        //! Rotate all vertices.
+        //! @param origin Rotation origin.
+        //! @param degrees Degrees of rotation.
+        void rotate(const Point &origin, int degrees);
+        //! Apply an affine transform to all vertices.
+        //! @param t The transform.
+        void transform(const AffineTransform &t);
+
+    private:
+        //! X coordinates.
+        std::vector<int> xs_;
+        //! Y coordinates.
+        std::vector<int> ys_;
+    };
+}
+#endif
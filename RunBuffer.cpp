@@ -0,0 +1,128 @@
+//! @file RunBuffer.cpp
+#include "RunBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace svg
+{
+    static const Color WHITE = {255, 255, 255};
+
+    static bool same_color(const Color &a, const Color &b)
+    {
+        return a.red == b.red && a.green == b.green && a.blue == b.blue;
+    }
+
+    RunBuffer::RunBuffer(int w, int h)
+        : width_(w), rows_(h, std::vector<ColorRun>(1, ColorRun{0, WHITE}))
+    {
+        assert(w > 0 && h > 0);
+    }
+
+    void RunBuffer::clear()
+    {
+        for (std::vector<ColorRun> &r : rows_)
+        {
+            r.assign(1, ColorRun{0, WHITE});
+        }
+    }
+
+    size_t RunBuffer::find(const std::vector<ColorRun> &r, int x)
+    {
+        auto it = std::upper_bound(r.begin(), r.end(), x,
+                                   [](int v, const ColorRun &run)
+                                   { return v < run.x; });
+        return (size_t)(it - r.begin()) - 1;
+    }
+
+    void RunBuffer::splice(int y, int x0, int x1, const ColorRun *runs, size_t n)
+    {
+        std::vector<ColorRun> &r = rows_[y];
+        size_t first = find(r, x0), last = find(r, x1);
+
+        // Replacement for runs first..last: the part of the first run
+        // before x0, the new runs, and the part of the last run after x1.
+        scratch_.clear();
+        if (r[first].x < x0)
+        {
+            scratch_.push_back(r[first]);
+        }
+        scratch_.insert(scratch_.end(), runs, runs + n);
+        if (x1 + 1 < width_ && (last + 1 == r.size() || r[last + 1].x != x1 + 1))
+        {
+            scratch_.push_back({x1 + 1, r[last].color});
+        }
+        r.erase(r.begin() + first, r.begin() + last + 1);
+        r.insert(r.begin() + first, scratch_.begin(), scratch_.end());
+
+        // Merge runs of the same color around the replaced ones.
+        size_t begin = first > 0 ? first : 1;
+        size_t end = std::min(first + scratch_.size() + 1, r.size());
+        size_t kept = begin;
+        for (size_t i = begin; i < end; i++)
+        {
+            if (!same_color(r[i].color, r[kept - 1].color))
+            {
+                r[kept++] = r[i];
+            }
+        }
+        r.erase(r.begin() + kept, r.begin() + end);
+    }
+
+    void RunBuffer::fill(int y, int x0, int x1, const Color &c)
+    {
+        ColorRun run = {x0, c};
+        splice(y, x0, x1, &run, 1);
+    }
+
+    void RunBuffer::set_pixels(int y, int x0, int n, const Color *colors)
+    {
+        pixel_runs_.clear();
+        for (int i = 0; i < n; i++)
+        {
+            if (pixel_runs_.empty() || !same_color(pixel_runs_.back().color, colors[i]))
+            {
+                pixel_runs_.push_back({x0 + i, colors[i]});
+            }
+        }
+        splice(y, x0, x0 + n - 1, pixel_runs_.data(), pixel_runs_.size());
+    }
+
+    Color RunBuffer::get(int x, int y) const
+    {
+        const std::vector<ColorRun> &r = rows_[y];
+        return r[find(r, x)].color;
+    }
+
+    const std::vector<ColorRun> &RunBuffer::row(int y) const
+    {
+        return rows_[y];
+    }
+
+    void RunBuffer::row_runs(int y, std::vector<ColorRun> &out) const
+    {
+        out = rows_[y];
+    }
+
+    void RunBuffer::expand(int y, int x0, int n, Color *out) const
+    {
+        const std::vector<ColorRun> &r = rows_[y];
+        int x = x0, end = x0 + n;
+        for (size_t i = find(r, x0); x < end; i++)
+        {
+            int run_end = std::min(i + 1 < r.size() ? r[i + 1].x : width_, end);
+            std::fill(out + (x - x0), out + (run_end - x0), r[i].color);
+            x = run_end;
+        }
+    }
+
+    size_t RunBuffer::memory() const
+    {
+        size_t bytes = rows_.capacity() * sizeof(std::vector<ColorRun>);
+        for (const std::vector<ColorRun> &r : rows_)
+        {
+            bytes += r.capacity() * sizeof(ColorRun);
+        }
+        return bytes;
+    }
+}
@@ -0,0 +1,82 @@
+//! @file RunBuffer.hpp
+#ifndef __svg_RunBuffer_hpp__
+#define __svg_RunBuffer_hpp__
+
+#include "PixelStore.hpp"
+
+#include <vector>
+
+namespace svg
+{
+    //! Pixels stored as runs: each row is a sorted list of runs of one
+    //! color covering the row, with no two consecutive runs of the same
+    //! color. Memory follows the number of color changes rather than the
+    //! number of pixels, so large canvases with a few flat shapes are
+    //! cheap to store and to write.
+    class RunBuffer : public PixelStore
+    {
+    public:
+        //! Constructor of a white buffer.
+        //! @param w Width.
+        //! @param h Height.
+        RunBuffer(int w, int h);
+        //! Set all pixels to white.
+        void clear() override;
+        //! Fill a span of a row, over what it covers.
+        //! @param y Y position.
+        //! @param x0 First X position (in the row).
+        //! @param x1 Last X position (in the row, at least x0).
+        //! @param c Color.
+        void fill(int y, int x0, int x1, const Color &c) override;
+        //! Set consecutive pixels of a row.
+        //! @param y Y position.
+        //! @param x0 First X position (in the row).
+        //! @param n Number of pixels (x0 + n at most the width).
+        //! @param colors Colors.
+        void set_pixels(int y, int x0, int n, const Color *colors) override;
+        //! Get a pixel.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Color.
+        Color get(int x, int y) const override;
+        //! Get the runs of a row.
+        //! @param y Y position.
+        //! @return Runs, the first at X 0.
+        const std::vector<ColorRun> &row(int y) const;
+        //! Get a row as runs (a copy of row()).
+        //! @param y Y position.
+        //! @param out Output runs.
+        void row_runs(int y, std::vector<ColorRun> &out) const override;
+        //! Expand part of a row to pixels.
+        //! @param y Y position.
+        //! @param x0 First X position.
+        //! @param n Number of pixels.
+        //! @param out Output pixels.
+        void expand(int y, int x0, int n, Color *out) const override;
+        //! Get the memory held by the runs.
+        //! @return Size in bytes.
+        size_t memory() const override;
+
+    private:
+        //! Replace the pixels of a row span with runs.
+        //! @param y Y position.
+        //! @param x0 First X position.
+        //! @param x1 Last X position.
+        //! @param runs Runs covering x0 to x1, the first at x0.
+        //! @param n Number of runs.
+        void splice(int y, int x0, int x1, const ColorRun *runs, size_t n);
+        //! Index of the run of a row holding a pixel.
+        //! @param r Runs of the row.
+        //! @param x X position.
+        //! @return Index.
+        static size_t find(const std::vector<ColorRun> &r, int x);
+
+        //! Width.
+        int width_;
+        //! Runs of each row.
+        std::vector<std::vector<ColorRun>> rows_;
+        //! Scratch runs.
+        std::vector<ColorRun> scratch_, pixel_runs_;
+    };
+}
+#endif
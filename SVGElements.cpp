@@ -1,22 +1,201 @@
 #include "SVGElements.hpp"
+#include <algorithm>
 #include <iostream>
+#include <functional>
 #include <memory>
+#include <cstdlib>
+#include <cmath>
 using namespace std;
 
 namespace svg {
-    SVGElement::SVGElement() {}
+    // Implementation for Transform
+    Transform Transform::translate(const Point& translation) {
+        return {TRANSLATE, translation, 0, {0, 0}};
+    }
+
+    Transform Transform::rotate(const Point& origin, int degrees) {
+        return {ROTATE, {0, 0}, degrees, origin};
+    }
+
+    Transform Transform::scale(const Point& origin, int scaling_factor) {
+        return {SCALE, {0, 0}, scaling_factor, origin};
+    }
+
+    void Transform::apply(SVGElement& element) const {
+        switch (kind) {
+            case TRANSLATE:
+                element.translate(translation);
+                break;
+            case ROTATE:
+                element.rotate(origin, amount);
+                break;
+            case SCALE:
+                element.scale(origin, amount);
+                break;
+        }
+    }
+
+    SVGElement::SVGElement() : opacity(1), gradientBox{{0, 0}, {-1, -1}} {}
     SVGElement::~SVGElement() {}
 
+    void SVGElement::render(PNGImage& img) const {
+        if (opacity >= 1) {
+            draw(img);
+            return;
+        }
+        if (opacity <= 0) {
+            return;
+        }
+        std::unique_ptr<PNGImage> layer = img.begin_layer(bounds());
+        if (layer) {
+            draw(*layer);
+            img.end_layer(*layer, opacity);
+        }
+    }
+
+    void SVGElement::flatten(std::vector<const SVGElement*>& leaves,
+                             std::vector<const SVGElement*>& owners,
+                             const SVGElement* owner) const {
+        leaves.push_back(this);
+        owners.push_back(id.empty() ? owner : this);
+    }
+
+    void SVGElement::resolveReferences(const Definitions&, std::vector<std::string>&) {}
+
+    // Implementation for Definitions
+    void Definitions::define(const std::string& id, const SVGElement& element) {
+        uint32_t symbol = ids.intern(id);
+        if (elements.size() <= symbol) {
+            elements.resize(symbol + 1);
+        }
+        elements[symbol] = element.clone();
+    }
+
+    void Definitions::merge(Definitions&& later) {
+        for (uint32_t s = 0; s < later.elements.size(); s++) {
+            if (later.elements[s]) {
+                uint32_t symbol = ids.intern(later.ids.name(s));
+                if (elements.size() <= symbol) {
+                    elements.resize(symbol + 1);
+                }
+                elements[symbol] = std::move(later.elements[s]);
+            }
+        }
+        later = Definitions();
+    }
+
+    const SVGElement* Definitions::find(const std::string& id) const {
+        uint32_t symbol = ids.find(id);
+        return symbol < elements.size() ? elements[symbol].get() : nullptr;
+    }
+
+    void Definitions::resolveReferences(const Definitions& definitions) {
+        std::vector<std::string> resolving;
+        for (auto& element : elements) {
+            if (element) {
+                element->resolveReferences(definitions, resolving);
+            }
+        }
+    }
+
+    bool SVGElement::occluder(std::vector<Point>&) const {
+        return false;
+    }
+
+    size_t SVGElement::vertexCount() const {
+        return 0;
+    }
+
+    bool SVGElement::paintColors(std::vector<Color>&) const {
+        return false;
+    }
+
+    // Appends the color of an element painted with one flat color
+    static bool flatColor(const SVGElement& element, const Color& color, std::vector<Color>& colors) {
+        if (element.gradient || element.opacity < 1) {
+            return false;
+        }
+        colors.push_back(color);
+        return true;
+    }
+
+    // Scale a point around the document origin, rounding to the nearest pixel
+    static Point zoomPoint(const Point& p, double factor) {
+        return {(int) std::lround(p.x * factor), (int) std::lround(p.y * factor)};
+    }
+
+    // Scale a stroke width; hairlines stay one pixel wide
+    static void zoomStroke(StrokeStyle& style, double factor) {
+        if (!style.thin()) {
+            style.width *= factor;
+        }
+    }
+
+    // Grow a box by a margin on every side
+    static BoundingBox growBox(const BoundingBox& box, int margin) {
+        if (box.empty()) {
+            return box;
+        }
+        return {box.min.translate({-margin, -margin}), box.max.translate({margin, margin})};
+    }
+
+    // Check if a wide stroke drawn by PNGImage::draw_polyline paints in a region
+    static bool strokePaints(const std::vector<Point>& points, const StrokeStyle& style, const BoundingBox& region) {
+        StrokeOutline outline(points, style);
+        BoundingBox box = outline.bounds().intersection(region);
+        std::vector<Point> spans;
+        for (int y = box.min.y; y <= box.max.y; y++) {
+            outline.row_spans(y, spans);
+            for (const Point& span : spans) {
+                if (span.x <= region.max.x && span.y >= region.min.x) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Check if an ellipse drawn by PNGImage::draw_ellipse paints in a region
+    static bool ellipsePaints(const Point& center, const Point& radius, const BoundingBox& region) {
+        Point r{std::abs(radius.x), std::abs(radius.y)};
+        BoundingBox box = BoundingBox{center.translate({-r.x, -r.y}), center.translate(r)}.intersection(region);
+        for (int y = box.min.y; y <= box.max.y; y++) {
+            int w = PNGImage::ellipse_half_width(radius, y - center.y);
+            if (w >= 0 && center.x - w <= region.max.x && center.x + w >= region.min.x) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     // Add a transformation to the element
-    void SVGElement::addTransformation(const std::function<void()>& transformation) {
+    void SVGElement::addTransformation(const Transform& transformation) {
         transformations.push_back(transformation);
     }
     
+    // Paints an element with its gradient, if any, for the duration of a scope
+    struct PaintScope {
+        PNGImage& img;
+        std::unique_ptr<GradientShader> shader;
+        PaintScope(PNGImage& img, const SVGElement& element)
+                : PaintScope(img, element.gradient.get(), element.bounds(), element.gradientBox) {}
+        PaintScope(PNGImage& img, const Gradient* gradient, const BoundingBox& box, const BoundingBox& reference) : img(img) {
+            if (gradient) {
+                shader = std::make_unique<GradientShader>(*gradient, box, reference);
+                img.set_shader(shader.get());
+            }
+        }
+        ~PaintScope() {
+            img.set_shader(nullptr);
+        }
+    };
+
      // Implementation for Ellipse
     Ellipse::Ellipse(const Color& fill, const Point& center, const Point& radius)
             : fill(fill), center(center), radius(radius) {}
 
     void Ellipse::draw(PNGImage& img) const {
+        PaintScope scope(img, *this);
         img.draw_ellipse(center, radius, fill);
     }
 
@@ -35,17 +214,23 @@ namespace svg {
         center = center.rotate(origin, degrees);
     }
 
+    void Ellipse::zoom(double factor) {
+        center = zoomPoint(center, factor);
+        radius = zoomPoint(radius, factor);
+    }
+
     void Ellipse::applyTransformations() {
         for (const auto& transform : transformations) {
-            transform();
+            transform.apply(*this);
         }
+        transformations.clear();
     }
 
     void Ellipse::setTransformOrigin(const Point& origin) {
         transformOrigin = origin;
     }
 
-    void Ellipse::addTransformation(const std::function<void()>& transformation) {
+    void Ellipse::addTransformation(const Transform& transformation) {
         transformations.push_back(transformation);
     }
 
@@ -53,15 +238,27 @@ namespace svg {
         return std::make_unique<Ellipse>(*this);
     }
 
+    BoundingBox Ellipse::bounds() const {
+        Point r{std::abs(radius.x), std::abs(radius.y)};
+        return {center.translate({-r.x, -r.y}), center.translate(r)};
+    }
+
+    bool Ellipse::paints(const BoundingBox& region) const {
+        return ellipsePaints(center, radius, region);
+    }
+
+    bool Ellipse::paintColors(std::vector<Color>& colors) const {
+        return flatColor(*this, fill, colors);
+    }
+
     // Implementation for Circle
     Circle::Circle(const Color& fill, const Point& center, int radius)
             : fill(fill), center(center), radius(radius) {}
 
     void Circle::draw(PNGImage& img) const {
+        PaintScope scope(img, *this);
         Point radiusPoint{radius, radius};
-        if (center.x >= 0 && center.x < img.width() && center.y >= 0 && center.y < img.height()) {
-            img.draw_ellipse(center, radiusPoint, fill);
-        }
+        img.draw_ellipse(center, radiusPoint, fill);
     }
 
     void Circle::translate(const Point& translation) {
@@ -77,9 +274,14 @@ namespace svg {
         center = center.rotate(origin, degrees);
     }
 
+    void Circle::zoom(double factor) {
+        center = zoomPoint(center, factor);
+        radius = (int) std::lround(radius * factor);
+    }
+
     void Circle::applyTransformations() {
         for (const auto& transform : transformations) {
-            transform();
+            transform.apply(*this);
         }
         transformations.clear();
     }
@@ -88,7 +290,7 @@ namespace svg {
         transformOrigin = origin;
     }
 
-    void Circle::addTransformation(const std::function<void()>& transformation) {
+    void Circle::addTransformation(const Transform& transformation) {
         transformations.push_back(transformation);
     }
 
@@ -96,45 +298,61 @@ namespace svg {
         return std::make_unique<Circle>(*this);
     }
 
+    BoundingBox Circle::bounds() const {
+        int r = std::abs(radius);
+        return {center.translate({-r, -r}), center.translate({r, r})};
+    }
+
+    bool Circle::paints(const BoundingBox& region) const {
+        return ellipsePaints(center, Point{radius, radius}, region);
+    }
+
+    bool Circle::paintColors(std::vector<Color>& colors) const {
+        return flatColor(*this, fill, colors);
+    }
+
     // Implementation for Polyline
-    Polyline::Polyline(const Color& stroke, const std::vector<Point>& points)
-            : stroke(stroke), points(points) {}
+    Polyline::Polyline(const Color& stroke, const std::vector<Point>& points, const StrokeStyle& style)
+            : stroke(stroke), style(style), points(points) {}
 
     void Polyline::draw(PNGImage& img) const {
-        for (size_t i = 0; i < points.size() - 1; ++i) {
-            img.draw_line(points[i], points[i + 1], stroke);
-        }
+        PaintScope scope(img, *this);
+        img.draw_polyline(points.to_vector(), stroke, style);
     }
 
     void Polyline::translate(const Point& translation) {
-        for (Point& p : points) {
-            p = p.translate(translation);
-        }
+        points.translate(translation);
     }
 
     void Polyline::scale(const Point& origin, int scaling_factor) {
-        for (Point& p : points) {
-            p = p.scale(origin, scaling_factor);
+        points.scale(origin, scaling_factor);
+        // Hairlines stay one pixel wide at any scale.
+        if (!style.thin()) {
+            style.width *= std::abs(scaling_factor);
         }
     }
 
     void Polyline::rotate(const Point& origin, int degrees) {
-        for (Point& p : points) {
-            p = p.rotate(origin, degrees);
-        }
+        points.rotate(origin, degrees);
+    }
+
+    void Polyline::zoom(double factor) {
+        points.transform({factor, 0, 0, factor, {0, 0}});
+        zoomStroke(style, factor);
     }
 
     void Polyline::applyTransformations() {
         for (const auto& transform : transformations) {
-            transform();
+            transform.apply(*this);
         }
+        transformations.clear();
     }
 
     void Polyline::setTransformOrigin(const Point& origin) {
         transformOrigin = origin;
     }
 
-    void Polyline::addTransformation(const std::function<void()>& transformation) {
+    void Polyline::addTransformation(const Transform& transformation) {
         transformations.push_back(transformation);
     }
 
@@ -142,12 +360,40 @@ namespace svg {
         return std::make_unique<Polyline>(*this);
     }
 
+    BoundingBox Polyline::bounds() const {
+        return growBox(points.bounds(), style.margin());
+    }
+
+    bool Polyline::paints(const BoundingBox& region) const {
+        if (points.size() < 2 || style.width <= 0 || !bounds().intersects(region)) {
+            return false;
+        }
+        if (!style.thin()) {
+            return strokePaints(points.to_vector(), style, region);
+        }
+        for (size_t i = 0; i + 1 < points.size(); ++i) {
+            if (PNGImage::line_hits(points[i], points[i + 1], region)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t Polyline::vertexCount() const {
+        return points.size();
+    }
+
+    bool Polyline::paintColors(std::vector<Color>& colors) const {
+        return flatColor(*this, stroke, colors);
+    }
+
     // Implementation for Line
-    Line::Line(const Color& stroke, const Point& start, const Point& end)
-            : stroke(stroke), start(start), end(end) {}
+    Line::Line(const Color& stroke, const Point& start, const Point& end, const StrokeStyle& style)
+            : stroke(stroke), style(style), start(start), end(end) {}
 
     void Line::draw(PNGImage& img) const {
-        img.draw_line(start, end, stroke);
+        PaintScope scope(img, *this);
+        img.draw_polyline({start, end}, stroke, style);
     }
 
     void Line::translate(const Point& translation) {
@@ -158,6 +404,10 @@ namespace svg {
     void Line::scale(const Point& origin, int scaling_factor) {
         start = start.scale(origin, scaling_factor);
         end = end.scale(origin, scaling_factor);
+        // Hairlines stay one pixel wide at any scale.
+        if (!style.thin()) {
+            style.width *= std::abs(scaling_factor);
+        }
     }
 
     void Line::rotate(const Point& origin, int degrees) {
@@ -165,17 +415,24 @@ namespace svg {
         end = end.rotate(origin, degrees);
     }
 
+    void Line::zoom(double factor) {
+        start = zoomPoint(start, factor);
+        end = zoomPoint(end, factor);
+        zoomStroke(style, factor);
+    }
+
     void Line::applyTransformations() {
         for (const auto& transform : transformations) {
-            transform();
+            transform.apply(*this);
         }
+        transformations.clear();
     }
 
     void Line::setTransformOrigin(const Point& origin) {
         transformOrigin = origin;
     }
 
-    void Line::addTransformation(const std::function<void()>& transformation) {
+    void Line::addTransformation(const Transform& transformation) {
         transformations.push_back(transformation);
     }
 
@@ -183,43 +440,66 @@ namespace svg {
         return std::make_unique<Line>(*this);
     }
 
+    BoundingBox Line::bounds() const {
+        Point ends[] = {start, end};
+        return growBox(BoundingBox::around(ends, 2), style.margin());
+    }
+
+    bool Line::paints(const BoundingBox& region) const {
+        if (style.width <= 0) {
+            return false;
+        }
+        if (!style.thin()) {
+            return strokePaints({start, end}, style, region);
+        }
+        return PNGImage::line_hits(start, end, region);
+    }
+
+    size_t Line::vertexCount() const {
+        return 2;
+    }
+
+    bool Line::paintColors(std::vector<Color>& colors) const {
+        return flatColor(*this, stroke, colors);
+    }
+
     // Implementation for Polygon
     Polygon::Polygon(const Color& fill, const std::vector<Point>& points)
             : fill(fill), points(points) {}
 
     void Polygon::draw(PNGImage& img) const {
-        img.draw_polygon(points, fill);
+        PaintScope scope(img, *this);
+        img.draw_polygon(points.to_vector(), fill);
     }
 
     void Polygon::translate(const Point& translation) {
-        for (Point& p : points) {
-            p = p.translate(translation);
-        }
+        points.translate(translation);
     }
 
     void Polygon::scale(const Point& origin, int scaling_factor) {
-        for (Point& p : points) {
-            p = p.scale(origin, scaling_factor);
-        }
+        points.scale(origin, scaling_factor);
     }
 
     void Polygon::rotate(const Point& origin, int degrees) {
-        for (Point& p : points) {
-            p = p.rotate(origin, degrees);
-        }
+        points.rotate(origin, degrees);
+    }
+
+    void Polygon::zoom(double factor) {
+        points.transform({factor, 0, 0, factor, {0, 0}});
     }
 
     void Polygon::applyTransformations() {
         for (const auto& transform : transformations) {
-            transform();
+            transform.apply(*this);
         }
+        transformations.clear();
     }
 
     void Polygon::setTransformOrigin(const Point& origin) {
         transformOrigin = origin;
     }
 
-    void Polygon::addTransformation(const std::function<void()>& transformation) {
+    void Polygon::addTransformation(const Transform& transformation) {
         transformations.push_back(transformation);
     }
 
@@ -227,6 +507,73 @@ namespace svg {
         return std::make_unique<Polygon>(*this);
     }
 
+    BoundingBox Polygon::bounds() const {
+        return points.bounds();
+    }
+
+    bool Polygon::paints(const BoundingBox& region) const {
+        BoundingBox box = points.bounds();
+        if (!box.intersects(region)) {
+            return false;
+        }
+        std::vector<Point> vertices = points.to_vector();
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (PNGImage::line_hits(vertices[i], vertices[(i + 1) % vertices.size()], region)) {
+                return true;
+            }
+        }
+        // Fill rows are box.min.y .. box.max.y - 1 (the last row is outline only).
+        std::vector<double> seg;
+        std::vector<Point> spans;
+        for (int y = std::max(box.min.y, region.min.y); y <= std::min(box.max.y - 1, region.max.y); y++) {
+            PNGImage::polygon_spans(vertices, y, seg, spans);
+            for (const Point& span : spans) {
+                if (span.x <= region.max.x && span.y >= region.min.x) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    size_t Polygon::vertexCount() const {
+        return points.size();
+    }
+
+    bool Polygon::paintColors(std::vector<Color>& colors) const {
+        return flatColor(*this, fill, colors);
+    }
+
+    bool Polygon::occluder(std::vector<Point>& outline) const {
+        // Convex: all turns have the same direction, and the outline
+        // changes horizontal direction at most twice (so it winds once).
+        size_t n = points.size();
+        long long turn = 0;
+        int x_flips = 0, x_dir = 0;
+        for (size_t i = 0; i < n; i++) {
+            Point a = points[i], b = points[(i + 1) % n], c = points[(i + 2) % n];
+            long long cross = (long long) (b.x - a.x) * (c.y - b.y) - (long long) (b.y - a.y) * (c.x - b.x);
+            if (cross != 0) {
+                if (turn != 0 && (cross > 0) != (turn > 0)) {
+                    return false;
+                }
+                turn = cross;
+            }
+            int dir = (b.x > a.x) - (b.x < a.x);
+            if (dir != 0) {
+                if (x_dir != 0 && dir != x_dir) {
+                    x_flips++;
+                }
+                x_dir = dir;
+            }
+        }
+        if (turn == 0 || x_flips > 2) {
+            return false;
+        }
+        outline = points.to_vector();
+        return true;
+    }
+
     // Implementation for Rectangle 
     std::vector<Point> rectangleCoordinates(const Point& topLeft, const int& width, const int& height){
         Point topRight, bottomLeft, bottomRight;
@@ -245,12 +592,170 @@ namespace svg {
     : Polygon(fill, (rectangleCoordinates(topLeft, width, height))){}
 
 
+    // Implementation for Path
+    constexpr double Path::PATH_TOLERANCE;
+
+    PathPaint::PathPaint() : painted(false), color{0, 0, 0}, opacity(1) {}
+
+    Path::Path(const PathData& data, FillRule rule, const PathPaint& fill, const PathPaint& stroke, const StrokeStyle& style)
+            : data(data), rule(rule), fill(fill), stroke(stroke), style(style) {}
+
+    // Draws one part of a path with its paint, on a layer if translucent
+    static void drawPathPart(PNGImage& img, const Path& path, const PathPaint& paint,
+                             const std::function<void(PNGImage&)>& draw) {
+        if (!paint.painted || paint.opacity <= 0) {
+            return;
+        }
+        std::unique_ptr<PNGImage> layer;
+        if (paint.opacity < 1) {
+            layer = img.begin_layer(path.bounds());
+            if (!layer) {
+                return;
+            }
+        }
+        PNGImage& target = layer ? *layer : img;
+        {
+            PaintScope scope(target, paint.gradient.get(), path.bounds(), path.gradientBox);
+            draw(target);
+        }
+        if (layer) {
+            img.end_layer(*layer, paint.opacity);
+        }
+    }
+
+    std::vector<std::vector<Point>> Path::strokeLines(const std::vector<Contour>& contours) {
+        std::vector<std::vector<Point>> lines;
+        for (const Contour& contour : contours) {
+            std::vector<Point> line;
+            for (const Vec2& v : contour.points) {
+                Point p{(int) std::lround(v.x), (int) std::lround(v.y)};
+                if (line.empty() || p.x != line.back().x || p.y != line.back().y) {
+                    line.push_back(p);
+                }
+            }
+            if (contour.closed && line.size() > 1) {
+                line.push_back(line.front());
+            }
+            lines.push_back(std::move(line));
+        }
+        return lines;
+    }
+
+    void Path::draw(PNGImage& img) const {
+        std::vector<Contour> contours;
+        data.flatten(PATH_TOLERANCE, contours);
+        drawPathPart(img, *this, fill, [&](PNGImage& target) {
+            target.fill_contours(contours, rule, fill.color);
+        });
+        if (style.width > 0) {
+            drawPathPart(img, *this, stroke, [&](PNGImage& target) {
+                for (const std::vector<Point>& line : strokeLines(contours)) {
+                    target.draw_polyline(line, stroke.color, style);
+                }
+            });
+        }
+    }
+
+    void Path::translate(const Point& translation) {
+        data.translate({(double) translation.x, (double) translation.y});
+    }
+
+    void Path::scale(const Point& origin, int scaling_factor) {
+        data.transform({(double) scaling_factor, 0, 0, (double) scaling_factor, origin});
+        // Hairlines stay one pixel wide at any scale.
+        if (!style.thin()) {
+            style.width *= std::abs(scaling_factor);
+        }
+    }
+
+    void Path::rotate(const Point& origin, int degrees) {
+        data.transform(AffineTransform::rotation(origin, degrees));
+    }
+
+    void Path::zoom(double factor) {
+        data.transform({factor, 0, 0, factor, {0, 0}});
+        zoomStroke(style, factor);
+    }
+
+    void Path::applyTransformations() {
+        for (const auto& transform : transformations) {
+            transform.apply(*this);
+        }
+        transformations.clear();
+    }
+
+    void Path::setTransformOrigin(const Point& origin) {
+        transformOrigin = origin;
+    }
+
+    void Path::addTransformation(const Transform& transformation) {
+        transformations.push_back(transformation);
+    }
+
+    std::unique_ptr<SVGElement> Path::clone() const {
+        return std::make_unique<Path>(*this);
+    }
+
+    BoundingBox Path::bounds() const {
+        return growBox(data.bounds(), stroke.painted ? style.margin() : 0);
+    }
+
+    bool Path::paints(const BoundingBox& region) const {
+        if (!bounds().intersects(region)) {
+            return false;
+        }
+        std::vector<Contour> contours;
+        data.flatten(PATH_TOLERANCE, contours);
+        if (fill.painted) {
+            ContourFill area(contours, rule);
+            BoundingBox box = area.bounds().intersection(region);
+            std::vector<Point> spans;
+            for (int y = box.min.y; y <= box.max.y; y++) {
+                area.row_spans(y, spans);
+                for (const Point& span : spans) {
+                    if (span.x <= region.max.x && span.y >= region.min.x) {
+                        return true;
+                    }
+                }
+            }
+        }
+        if (stroke.painted && style.width > 0) {
+            for (const std::vector<Point>& line : strokeLines(contours)) {
+                if (!style.thin()) {
+                    if (strokePaints(line, style, region)) {
+                        return true;
+                    }
+                    continue;
+                }
+                for (size_t i = 0; i + 1 < line.size(); ++i) {
+                    if (PNGImage::line_hits(line[i], line[i + 1], region)) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    size_t Path::vertexCount() const {
+        return data.vertex_estimate(PATH_TOLERANCE);
+    }
+
+    bool Path::paintColors(std::vector<Color>& colors) const {
+        for (const PathPaint* paint : {&fill, &stroke}) {
+            if (paint->painted && (paint->gradient || paint->opacity < 1 || !flatColor(*this, paint->color, colors))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     // Implementation for Group
     SVGGroup::SVGGroup() {}
 
     void SVGGroup::draw(PNGImage& img) const {
         for (const auto& element : elements) {
-            element->draw(img);
+            element->render(img);
         }
     }
 
@@ -272,9 +777,15 @@ namespace svg {
         }
     }
 
+    void SVGGroup::zoom(double factor) {
+        for (auto& element : elements) {
+            element->zoom(factor);
+        }
+    }
+
     void SVGGroup::applyTransformations(){
         for (const auto& transform : transformations) {
-            transform();
+            transform.apply(*this);
         }
         transformations.clear();
     }
@@ -286,7 +797,7 @@ namespace svg {
         }
     }
 
-    void SVGGroup::addTransformation(const std::function<void()>& transformation) {
+    void SVGGroup::addTransformation(const Transform& transformation) {
         transformations.push_back(transformation);
     }
 
@@ -298,9 +809,182 @@ namespace svg {
         auto clonedGroup = std::make_unique<SVGGroup>();
         clonedGroup->id = this->id;
         clonedGroup->transformations = this->transformations;
+        clonedGroup->opacity = this->opacity;
         for (const auto& element : elements) {
             clonedGroup->elements.push_back(element->clone());
         }
         return clonedGroup;
     }
+
+    BoundingBox SVGGroup::bounds() const {
+        BoundingBox box = {{0, 0}, {-1, -1}};
+        for (const auto& element : elements) {
+            box = box.merge(element->bounds());
+        }
+        return box;
+    }
+
+    bool SVGGroup::paints(const BoundingBox& region) const {
+        for (const auto& element : elements) {
+            if (element->paints(region)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t SVGGroup::vertexCount() const {
+        size_t count = 0;
+        for (const auto& element : elements) {
+            count += element->vertexCount();
+        }
+        return count;
+    }
+
+    void SVGGroup::flatten(std::vector<const SVGElement*>& leaves,
+                           std::vector<const SVGElement*>& owners,
+                           const SVGElement* owner) const {
+        if (opacity < 1) {
+            SVGElement::flatten(leaves, owners, owner);
+            return;
+        }
+        for (const auto& element : elements) {
+            element->flatten(leaves, owners, id.empty() ? owner : this);
+        }
+    }
+
+    void SVGGroup::resolveReferences(const Definitions& definitions, std::vector<std::string>& resolving) {
+        if (!id.empty()) {
+            resolving.push_back(id);
+        }
+        for (auto& element : elements) {
+            element->resolveReferences(definitions, resolving);
+        }
+        if (!id.empty()) {
+            resolving.pop_back();
+        }
+    }
+
+    // Implementation for Use
+    const int Use::MAX_DEPTH;
+
+    Use::Use(const std::string& target) : target(target) {}
+
+    void Use::draw(PNGImage& img) const {
+        if (resolved) {
+            resolved->render(img);
+        }
+    }
+
+    void Use::translate(const Point& translation) {
+        if (resolved) {
+            resolved->translate(translation);
+        } else {
+            recorded.push_back(Transform::translate(translation));
+        }
+    }
+
+    void Use::scale(const Point& origin, int scaling_factor) {
+        if (resolved) {
+            resolved->scale(origin, scaling_factor);
+        } else {
+            recorded.push_back(Transform::scale(origin, scaling_factor));
+        }
+    }
+
+    void Use::rotate(const Point& origin, int degrees) {
+        if (resolved) {
+            resolved->rotate(origin, degrees);
+        } else {
+            recorded.push_back(Transform::rotate(origin, degrees));
+        }
+    }
+
+    void Use::zoom(double factor) {
+        if (resolved) {
+            resolved->zoom(factor);
+        }
+    }
+
+    void Use::applyTransformations() {
+        for (const auto& transform : transformations) {
+            transform.apply(*this);
+        }
+        transformations.clear();
+    }
+
+    void Use::setTransformOrigin(const Point& origin) {
+        transformOrigin = origin;
+        if (resolved) {
+            resolved->setTransformOrigin(origin);
+        }
+    }
+
+    void Use::addTransformation(const Transform& transformation) {
+        transformations.push_back(transformation);
+    }
+
+    std::unique_ptr<SVGElement> Use::clone() const {
+        auto clonedUse = std::make_unique<Use>(target);
+        clonedUse->id = id;
+        clonedUse->transformations = transformations;
+        clonedUse->opacity = opacity;
+        clonedUse->recorded = recorded;
+        clonedUse->transformOrigin = transformOrigin;
+        if (resolved) {
+            clonedUse->resolved = resolved->clone();
+        }
+        return clonedUse;
+    }
+
+    BoundingBox Use::bounds() const {
+        return resolved ? resolved->bounds() : BoundingBox{{0, 0}, {-1, -1}};
+    }
+
+    bool Use::paints(const BoundingBox& region) const {
+        return resolved && resolved->paints(region);
+    }
+
+    bool Use::occluder(std::vector<Point>& outline) const {
+        return resolved && resolved->occluder(outline);
+    }
+
+    size_t Use::vertexCount() const {
+        return resolved ? resolved->vertexCount() : 0;
+    }
+
+    void Use::flatten(std::vector<const SVGElement*>& leaves,
+                      std::vector<const SVGElement*>& owners,
+                      const SVGElement* owner) const {
+        if (resolved && opacity < 1) {
+            SVGElement::flatten(leaves, owners, owner);
+        } else if (resolved) {
+            resolved->flatten(leaves, owners, id.empty() ? owner : this);
+        }
+    }
+
+    void Use::resolveReferences(const Definitions& definitions, std::vector<std::string>& resolving) {
+        if (resolved) {
+            resolving.push_back(target);
+            resolved->resolveReferences(definitions, resolving);
+            resolving.pop_back();
+            return;
+        }
+        // A target being resolved around this reference contains it: copying
+        // it would repeat the copy at every level, so the cycle draws nothing.
+        const SVGElement* definition = definitions.find(target);
+        if (definition == nullptr || resolving.size() >= (size_t) MAX_DEPTH ||
+            std::find(resolving.begin(), resolving.end(), target) != resolving.end()) {
+            return;
+        }
+        resolved = definition->clone();
+        resolving.push_back(target);
+        resolved->resolveReferences(definitions, resolving);
+        resolving.pop_back();
+        resolved->setTransformOrigin(transformOrigin);
+        for (const Transform& transform : recorded) {
+            transform.apply(*resolved);
+        }
+        recorded.clear();
+    }
 }
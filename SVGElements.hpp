@@ -1,17 +1,69 @@
 #ifndef __svg_SVGElements_hpp__
 #define __svg_SVGElements_hpp__
 
-#include <functional>
 #include <vector>
 #include <memory>
 #include <string>
 #include "Color.hpp"
 #include "Point.hpp"
 #include "PNGImage.hpp"
+#include "Gradient.hpp"
+#include "PathData.hpp"
+#include "PointBatch.hpp"
+#include "IdTable.hpp"
 #include "make_unique.h" 
 
 namespace svg
 {
+    class SVGElement;
+    class Definitions;
+
+    /**
+     * @brief Plain-data description of a transformation.
+     */
+    struct Transform
+    {
+        /**
+         * @brief Kinds of transformation.
+         */
+        enum Kind
+        {
+            TRANSLATE, ///< Translation by a vector.
+            ROTATE,    ///< Rotation around an origin.
+            SCALE      ///< Scaling around an origin.
+        };
+        Kind kind; ///< The kind of transformation.
+        Point translation; ///< The translation vector (TRANSLATE only).
+        int amount; ///< Degrees (ROTATE) or scaling factor (SCALE).
+        Point origin; ///< The rotation or scaling origin.
+
+        /**
+         * @brief Creates a translation.
+         * @param translation The translation vector.
+         * @return The transformation.
+         */
+        static Transform translate(const Point &translation);
+        /**
+         * @brief Creates a rotation.
+         * @param origin The rotation origin.
+         * @param degrees The degrees of rotation.
+         * @return The transformation.
+         */
+        static Transform rotate(const Point &origin, int degrees);
+        /**
+         * @brief Creates a scaling.
+         * @param origin The scaling origin.
+         * @param scaling_factor The scaling factor.
+         * @return The transformation.
+         */
+        static Transform scale(const Point &origin, int scaling_factor);
+        /**
+         * @brief Applies the transformation to an element.
+         * @param element The element to transform.
+         */
+        void apply(SVGElement &element) const;
+    };
+
     /**
      * @brief Base class for SVG elements.
      */
@@ -19,15 +71,26 @@ namespace svg
     {
     public:
         std::string id; ///< The id of the element.
-        std::vector<std::function<void()>> transformations; ///< The transformations to be applied to the element.
+        std::vector<Transform> transformations; ///< The transformations to be applied to the element.
+        double opacity; ///< The opacity the element is blended with, in [0, 1] (default 1, opaque).
+        std::shared_ptr<const Gradient> gradient; ///< The gradient painting the element in place of its color, or null.
+        BoundingBox gradientBox; ///< The bounding box of the element when the gradient was attached (see GradientShader).
 
         SVGElement(); ///< Default constructor.
         virtual ~SVGElement(); ///< Destructor.
         /**
-         * @brief Draws the SVG element on the given image.
+         * @brief Draws the SVG element on the given image, ignoring its opacity.
          * @param img The image to draw on.
          */
         virtual void draw(PNGImage &img) const = 0;
+        /**
+         * @brief Draws the SVG element on the given image, blended with its opacity.
+         *
+         * A translucent element is drawn on a layer limited to its bounding box
+         * (see PNGImage::begin_layer()), so overlapping parts blend once.
+         * @param img The image to draw on.
+         */
+        void render(PNGImage &img) const;
         /**
          * @brief Translates the SVG element.
          * @param translation The translation point.
@@ -45,6 +108,11 @@ namespace svg
          * @param degrees The degrees of rotation.
          */
         virtual void rotate(const Point &origin, int degrees) = 0;
+        /**
+         * @brief Scales the SVG element around the document origin by a real factor.
+         * @param factor The scaling factor; coordinates are rounded to the nearest integer.
+         */
+        virtual void zoom(double factor) = 0;
         /**
          * @brief Clones the SVG element.
          * @return A unique pointer to the cloned element.
@@ -61,9 +129,89 @@ namespace svg
         virtual void setTransformOrigin(const Point& origin) = 0;
         /**
          * @brief Adds a transformation to the SVG element.
-         * @param transformation The transformation function.
+         * @param transformation The transformation.
+         */
+        virtual void addTransformation(const Transform& transformation) = 0;
+        /**
+         * @brief Gets the bounding box of the pixels the element may paint.
+         * @return The bounding box.
+         */
+        virtual BoundingBox bounds() const = 0;
+        /**
+         * @brief Checks if the element paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some pixel drawn by draw() lies in the region.
          */
-        virtual void addTransformation(const std::function<void()>& transformation) = 0;
+        virtual bool paints(const BoundingBox &region) const = 0;
+        /**
+         * @brief Gets a convex polygon whose interior the element paints with an opaque color.
+         * @param outline The vector to store the polygon vertices.
+         * @return true if the element is such an occluder; false by default.
+         */
+        virtual bool occluder(std::vector<Point> &outline) const;
+        /**
+         * @brief Gets the number of vertices the element is drawn from.
+         * @return The number of polygon, polyline or line vertices; 0 by default.
+         */
+        virtual size_t vertexCount() const;
+        /**
+         * @brief Gets the colors of the pixels the element draws, when known before drawing.
+         * @param colors The vector to append the colors to.
+         * @return true if the element draws only these colors; false by default, and for
+         *         elements painted with a gradient or blended with an opacity below 1.
+         */
+        virtual bool paintColors(std::vector<Color> &colors) const;
+        /**
+         * @brief Appends the primitive elements this element paints, in paint order.
+         * @param leaves The vector to append to.
+         * @param owners The vector to append, for each primitive element, the innermost
+         *               element with an id containing it (itself included), or nullptr.
+         * @param owner The innermost element with an id containing this element, or nullptr.
+         */
+        virtual void flatten(std::vector<const SVGElement *> &leaves,
+                             std::vector<const SVGElement *> &owners,
+                             const SVGElement *owner) const;
+        /**
+         * @brief Resolves the unresolved <use> references inside the element; none by default.
+         * @param definitions The definitions to copy referenced elements from.
+         * @param resolving The ids of the groups and references being resolved around this
+         *                  element, innermost last; a reference to one of them is a cycle.
+         */
+        virtual void resolveReferences(const Definitions &definitions, std::vector<std::string> &resolving);
+    };
+
+    /**
+     * @brief Copies of the elements with an id, for resolving <use> references.
+     */
+    class Definitions
+    {
+    public:
+        /**
+         * @brief Records a copy of an element as the definition of an id, replacing any previous one.
+         * @param id The id.
+         * @param element The element.
+         */
+        void define(const std::string &id, const SVGElement &element);
+        /**
+         * @brief Moves in the definitions of another set, which replace those of this set.
+         * @param later The definitions appearing later in the document; left empty.
+         */
+        void merge(Definitions &&later);
+        /**
+         * @brief Finds the definition of an id.
+         * @param id The id.
+         * @return The definition, or nullptr if the id is not defined.
+         */
+        const SVGElement *find(const std::string &id) const;
+        /**
+         * @brief Resolves the references within each definition.
+         * @param definitions The definitions to copy referenced elements from.
+         */
+        void resolveReferences(const Definitions &definitions);
+
+    private:
+        IdTable ids; ///< The interned ids.
+        std::vector<std::unique_ptr<SVGElement>> elements; ///< The definitions, by id symbol (null where undefined).
     };
 
     /**
@@ -71,10 +219,17 @@ namespace svg
      * @param svg_file The path to the SVG file.
      * @param dimensions The dimensions of the SVG.
      * @param svg_elements The vector to store SVG elements.
+     * @param cancel The token polled before each element is parsed, or nullptr.
+     *               If parsing is cancelled, elements already stored stay owned by the caller.
+     * @param threads The number of threads parsing top-level elements; documents with few
+     *                top-level elements are parsed on the calling thread. The result does not
+     *                depend on the number of threads.
      */
     void readSVG(const std::string &svg_file,
                  Point &dimensions,
-                 std::vector<SVGElement *> &svg_elements);
+                 std::vector<SVGElement *> &svg_elements,
+                 const CancellationToken *cancel = nullptr,
+                 unsigned threads = 1);
     /**
      * @brief Converts an SVG file to a PNG file.
      * @param svg_file The path to the SVG file.
@@ -118,6 +273,11 @@ namespace svg
          * @param degrees The degrees of rotation.
          */
         void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the ellipse around the document origin by a real factor.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
         /**
          * @brief Applies the transformations to the ellipse.
          */
@@ -129,14 +289,31 @@ namespace svg
         void setTransformOrigin(const Point& origin) override;
         /**
          * @brief Adds a transformation to the ellipse.
-         * @param transformation The transformation function.
+         * @param transformation The transformation.
          */
-        void addTransformation(const std::function<void()>& transformation) override;
+        void addTransformation(const Transform& transformation) override;
         /**
          * @brief Clones the ellipse.
          * @return A unique pointer to the cloned ellipse.
          */
         virtual std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the ellipse.
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the ellipse paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some pixel of the ellipse lies in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the colors of the pixels the ellipse draws.
+         * @param colors The vector to append the colors to.
+         * @return true unless the ellipse is painted with a gradient or translucent.
+         */
+        bool paintColors(std::vector<Color> &colors) const override;
 
     private:
         Color fill; ///< The fill color of the ellipse.
@@ -180,6 +357,11 @@ namespace svg
          * @param degrees The degrees of rotation.
          */
         void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the circle around the document origin by a real factor.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
         /**
          * @brief Applies the transformations to the circle.
          */
@@ -191,14 +373,31 @@ namespace svg
         void setTransformOrigin(const Point& origin) override;
         /**
          * @brief Adds a transformation to the circle.
-         * @param transformation The transformation function.
+         * @param transformation The transformation.
          */
-        void addTransformation(const std::function<void()>& transformation) override;
+        void addTransformation(const Transform& transformation) override;
         /**
          * @brief Clones the circle.
          * @return A unique pointer to the cloned circle.
          */
         virtual std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the circle.
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the circle paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some pixel of the circle lies in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the colors of the pixels the circle draws.
+         * @param colors The vector to append the colors to.
+         * @return true unless the circle is painted with a gradient or translucent.
+         */
+        bool paintColors(std::vector<Color> &colors) const override;
 
     private:
         Color fill; ///< The fill color of the circle.
@@ -217,8 +416,10 @@ namespace svg
          * @brief Constructs a Polyline object.
          * @param stroke The stroke color of the polyline.
          * @param points The points of the polyline.
+         * @param style The stroke style of the polyline.
          */
-        Polyline(const Color &stroke, const std::vector<Point> &points);
+        Polyline(const Color &stroke, const std::vector<Point> &points,
+                 const StrokeStyle &style = StrokeStyle());
         /**
          * @brief Draws the polyline on the image.
          * @param img The image to draw on.
@@ -241,6 +442,11 @@ namespace svg
          * @param degrees The degrees of rotation.
          */
         void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the polyline around the document origin by a real factor.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
         /**
          * @brief Applies the transformations to the polyline.
          */
@@ -252,18 +458,41 @@ namespace svg
         void setTransformOrigin(const Point& origin) override;
         /**
          * @brief Adds a transformation to the polyline.
-         * @param transformation The transformation function.
+         * @param transformation The transformation.
          */
-        void addTransformation(const std::function<void()>& transformation) override;
+        void addTransformation(const Transform& transformation) override;
         /**
          * @brief Clones the polyline.
          * @return A unique pointer to the cloned polyline.
          */
         virtual std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the polyline.
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the polyline paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some pixel of the polyline lies in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the number of vertices of the polyline.
+         * @return The number of vertices.
+         */
+        size_t vertexCount() const override;
+        /**
+         * @brief Gets the colors of the pixels the polyline draws.
+         * @param colors The vector to append the colors to.
+         * @return true unless the polyline is painted with a gradient or translucent.
+         */
+        bool paintColors(std::vector<Color> &colors) const override;
 
     private:
         Color stroke; ///< The stroke color of the polyline.
-        std::vector<Point> points; ///< The points of the polyline. 
+        StrokeStyle style; ///< The stroke style of the polyline.
+        PointBatch points; ///< The points of the polyline.
         Point transformOrigin; ///< The transformation origin point of the polyline.
     };
 
@@ -278,8 +507,10 @@ namespace svg
          * @param stroke The stroke color of the line.
          * @param start The start point of the line.
          * @param end The end point of the line.
+         * @param style The stroke style of the line.
          */
-        Line(const Color &stroke, const Point &start, const Point &end);
+        Line(const Color &stroke, const Point &start, const Point &end,
+             const StrokeStyle &style = StrokeStyle());
         /**
          * @brief Draws the line on the image.
          * @param img The image to draw on.
@@ -302,6 +533,11 @@ namespace svg
          * @param degrees The degrees of rotation.
          */
         void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the line around the document origin by a real factor.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
         /**
          * @brief Applies the transformations to the line.
          */
@@ -313,17 +549,40 @@ namespace svg
         void setTransformOrigin(const Point& origin) override;
         /**
          * @brief Adds a transformation to the line.
-         * @param transformation The transformation function.
+         * @param transformation The transformation.
          */
-        void addTransformation(const std::function<void()>& transformation) override;
+        void addTransformation(const Transform& transformation) override;
         /**
          * @brief Clones the line.
          * @return A unique pointer to the cloned line.
          */
         virtual std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the line.
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the line paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some pixel of the line lies in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the number of vertices of the line.
+         * @return The number of vertices.
+         */
+        size_t vertexCount() const override;
+        /**
+         * @brief Gets the colors of the pixels the line draws.
+         * @param colors The vector to append the colors to.
+         * @return true unless the line is painted with a gradient or translucent.
+         */
+        bool paintColors(std::vector<Color> &colors) const override;
 
     private:
         Color stroke; ///< The stroke color of the line.
+        StrokeStyle style; ///< The stroke style of the line.
         Point start; ///< The start point of the line.
         Point end; ///< The end point of the line.
         Point transformOrigin; ///< The transformation origin point of the line.
@@ -363,6 +622,11 @@ namespace svg
          * @param degrees The degrees of rotation.
          */
         void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the polygon around the document origin by a real factor.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
         /**
          * @brief Applies the transformations to the polygon.
          */
@@ -374,18 +638,46 @@ namespace svg
         void setTransformOrigin(const Point& origin) override;
         /**
          * @brief Adds a transformation to the polygon.
-         * @param transformation The transformation function.
+         * @param transformation The transformation.
          */
-        void addTransformation(const std::function<void()>& transformation) override;
+        void addTransformation(const Transform& transformation) override;
         /**
          * @brief Clones the polygon.
          * @return A unique pointer to the cloned polygon.
          */
         virtual std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the polygon.
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the polygon paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some pixel of the polygon lies in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the number of vertices of the polygon.
+         * @return The number of vertices.
+         */
+        size_t vertexCount() const override;
+        /**
+         * @brief Gets the polygon outline, if the polygon is convex.
+         * @param outline The vector to store the polygon vertices.
+         * @return true if the polygon is convex.
+         */
+        bool occluder(std::vector<Point> &outline) const override;
+        /**
+         * @brief Gets the colors of the pixels the polygon draws.
+         * @param colors The vector to append the colors to.
+         * @return true unless the polygon is painted with a gradient or translucent.
+         */
+        bool paintColors(std::vector<Color> &colors) const override;
 
     private:
         Color fill; ///< The fill color of the polygon.
-        std::vector<Point> points; ///< The points of the polygon.
+        PointBatch points; ///< The points of the polygon.
         Point transformOrigin; ///< The transformation origin point of the polygon.
     };
     
@@ -405,6 +697,122 @@ namespace svg
         Rectangle(const Point &topLeft, const int &width,const int &height, const Color &fill);
     };
     
+    /**
+     * @brief How one part of a path (its fill or its stroke) is painted.
+     */
+    struct PathPaint
+    {
+        PathPaint(); ///< Constructor of an unpainted part.
+        bool painted; ///< Whether the part is drawn (false for "none").
+        Color color; ///< The color.
+        std::shared_ptr<const Gradient> gradient; ///< The gradient painting in place of the color, or null.
+        double opacity; ///< The opacity the part is blended with, in [0, 1] (fill-opacity or stroke-opacity).
+    };
+
+    /**
+     * @brief Class representing a path in SVG.
+     *
+     * The geometry keeps its curves through transformations and is flattened
+     * when drawn, with a tolerance of PATH_TOLERANCE pixels.
+     */
+    class Path : public SVGElement
+    {
+    public:
+        static constexpr double PATH_TOLERANCE = 0.25; ///< The maximum distance in pixels between a curve and its drawn polyline.
+        /**
+         * @brief Constructs a Path object.
+         * @param data The geometry of the path.
+         * @param rule The rule deciding which points the fill covers.
+         * @param fill The paint of the fill.
+         * @param stroke The paint of the stroke, drawn over the fill.
+         * @param style The stroke style.
+         */
+        Path(const PathData &data, FillRule rule, const PathPaint &fill, const PathPaint &stroke, const StrokeStyle &style);
+        /**
+         * @brief Draws the path on the image: the fill, then the stroke of each subpath.
+         * @param img The image to draw on.
+         */
+        void draw(PNGImage &img) const override;
+        /**
+         * @brief Translates the path.
+         * @param translation The translation point.
+         */
+        void translate(const Point &translation) override;
+        /**
+         * @brief Scales the path.
+         * @param origin The origin point for scaling.
+         * @param scaling_factor The scaling factor.
+         */
+        void scale(const Point &origin, int scaling_factor) override;
+        /**
+         * @brief Rotates the path.
+         * @param origin The origin point for rotation.
+         * @param degrees The degrees of rotation.
+         */
+        void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the path around the document origin by a real factor.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
+        /**
+         * @brief Applies the transformations to the path.
+         */
+        void applyTransformations() override;
+        /**
+         * @brief Sets the transformation origin for the path.
+         * @param origin The transformation origin point.
+         */
+        void setTransformOrigin(const Point& origin) override;
+        /**
+         * @brief Adds a transformation to the path.
+         * @param transformation The transformation.
+         */
+        void addTransformation(const Transform& transformation) override;
+        /**
+         * @brief Clones the path.
+         * @return A unique pointer to the cloned path.
+         */
+        std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the path, stroke included.
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the path paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some pixel of the fill or the stroke lies in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the number of vertices the path is drawn from, once flattened.
+         * @return The estimated number of vertices.
+         */
+        size_t vertexCount() const override;
+        /**
+         * @brief Gets the colors of the pixels the path draws.
+         * @param colors The vector to append the colors to.
+         * @return true unless the path is painted with a gradient or translucent.
+         */
+        bool paintColors(std::vector<Color> &colors) const override;
+
+    private:
+        /**
+         * @brief Gets the stroked polylines of the flattened subpaths.
+         * @param contours The flattened subpaths.
+         * @return The polylines, closed subpaths ending at their first vertex.
+         */
+        static std::vector<std::vector<Point>> strokeLines(const std::vector<Contour> &contours);
+
+        PathData data; ///< The geometry of the path.
+        FillRule rule; ///< The fill rule.
+        PathPaint fill; ///< The paint of the fill.
+        PathPaint stroke; ///< The paint of the stroke.
+        StrokeStyle style; ///< The stroke style.
+        Point transformOrigin; ///< The transformation origin point of the path.
+    };
+
     /**
      * @brief Class representing a group of SVG elements.
      */
@@ -435,6 +843,11 @@ namespace svg
          * @param degrees The degrees of rotation.
          */
         void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the group around the document origin by a real factor.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
         /**
          * @brief Applies the transformations to the group.
          */ 
@@ -446,14 +859,47 @@ namespace svg
         void setTransformOrigin(const Point& origin) override;
         /**
          * @brief Adds a transformation to the group.
-         * @param transformation The transformation function.
+         * @param transformation The transformation.
          */
-        void addTransformation(const std::function<void()>& transformation) override;
+        void addTransformation(const Transform& transformation) override;
         /**
          * @brief Clones the group.
          * @return A unique pointer to the cloned group.
          */
         virtual std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the group.
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the group paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if some element of the group paints in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the number of vertices of the elements of the group.
+         * @return The total number of vertices.
+         */
+        size_t vertexCount() const override;
+        /**
+         * @brief Appends the primitive elements of the group, in paint order.
+         *
+         * A translucent group is blended as a whole, so it is appended itself.
+         * @param leaves The vector to append to.
+         * @param owners The vector to append the owner of each primitive element.
+         * @param owner The innermost element with an id containing the group, or nullptr.
+         */
+        void flatten(std::vector<const SVGElement *> &leaves,
+                     std::vector<const SVGElement *> &owners,
+                     const SVGElement *owner) const override;
+        /**
+         * @brief Resolves the unresolved <use> references in the group.
+         * @param definitions The definitions to copy referenced elements from.
+         * @param depth The number of references being resolved around the group.
+         */
+        void resolveReferences(const Definitions &definitions, std::vector<std::string> &resolving) override;
         /**
          * @brief Adds an element to the group.
          * @param element The element to add.
@@ -463,6 +909,119 @@ namespace svg
     private:
         Point transformOrigin; ///< The transformation origin point of the group.
     };
+
+    /**
+     * @brief Class representing a <use> whose target is defined later in the document.
+     *
+     * Until resolveReferences() copies the target, transformations are recorded
+     * instead of applied; they are then replayed on the copy, so the result is
+     * the same as if the target had been defined first. Once resolved, the
+     * element behaves as the copy.
+     */
+    class Use : public SVGElement
+    {
+    public:
+        static const int MAX_DEPTH = 32; ///< The maximum nesting of references (deeper ones draw nothing, as cycles do).
+        /**
+         * @brief Constructs an unresolved reference.
+         * @param target The id of the referenced element.
+         */
+        explicit Use(const std::string &target);
+        /**
+         * @brief Draws the referenced element, if resolved.
+         * @param img The image to draw on.
+         */
+        void draw(PNGImage &img) const override;
+        /**
+         * @brief Translates the reference.
+         * @param translation The translation point.
+         */
+        void translate(const Point &translation) override;
+        /**
+         * @brief Scales the reference.
+         * @param origin The origin point for scaling.
+         * @param scaling_factor The scaling factor.
+         */
+        void scale(const Point &origin, int scaling_factor) override;
+        /**
+         * @brief Rotates the reference.
+         * @param origin The origin point for rotation.
+         * @param degrees The degrees of rotation.
+         */
+        void rotate(const Point &origin, int degrees) override;
+        /**
+         * @brief Scales the referenced element around the document origin by a real factor, if resolved.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor) override;
+        /**
+         * @brief Applies the transformations to the reference.
+         */
+        void applyTransformations() override;
+        /**
+         * @brief Sets the transformation origin for the reference.
+         * @param origin The transformation origin point.
+         */
+        void setTransformOrigin(const Point& origin) override;
+        /**
+         * @brief Adds a transformation to the reference.
+         * @param transformation The transformation.
+         */
+        void addTransformation(const Transform& transformation) override;
+        /**
+         * @brief Clones the reference, resolved or not.
+         * @return A unique pointer to the cloned reference.
+         */
+        std::unique_ptr<SVGElement> clone() const override;
+        /**
+         * @brief Gets the bounding box of the referenced element (empty if unresolved).
+         * @return The bounding box.
+         */
+        BoundingBox bounds() const override;
+        /**
+         * @brief Checks if the referenced element paints at least one pixel of a region.
+         * @param region The region.
+         * @return true if resolved and the referenced element paints in the region.
+         */
+        bool paints(const BoundingBox &region) const override;
+        /**
+         * @brief Gets the outline of the referenced element, if it is an occluder.
+         * @param outline The vector to store the polygon vertices.
+         * @return true if resolved and the referenced element is an occluder.
+         */
+        bool occluder(std::vector<Point> &outline) const override;
+        /**
+         * @brief Gets the number of vertices of the referenced element.
+         * @return The number of vertices (0 if unresolved).
+         */
+        size_t vertexCount() const override;
+        /**
+         * @brief Appends the primitive elements of the referenced element, in paint order.
+         *
+         * A translucent reference is blended as a whole, so it is appended itself.
+         * @param leaves The vector to append to.
+         * @param owners The vector to append the owner of each primitive element.
+         * @param owner The innermost element with an id containing the reference, or nullptr.
+         */
+        void flatten(std::vector<const SVGElement *> &leaves,
+                     std::vector<const SVGElement *> &owners,
+                     const SVGElement *owner) const override;
+        /**
+         * @brief Copies the referenced element and replays the recorded transformations on it.
+         *
+         * Does nothing if the target is not among the definitions, so that resolution
+         * can run again with more definitions.
+         * @param definitions The definitions to copy the referenced element from.
+         * @param depth The number of references being resolved around this one.
+         */
+        void resolveReferences(const Definitions &definitions, std::vector<std::string> &resolving) override;
+
+    private:
+        std::string target; ///< The id of the referenced element.
+        std::vector<Transform> recorded; ///< The transformations received while unresolved.
+        Point transformOrigin; ///< The transformation origin point of the reference.
+        std::unique_ptr<SVGElement> resolved; ///< The copy of the referenced element, once resolved.
+    };
 }
 
 #endif
@@ -0,0 +1,441 @@
+#include "Scene.hpp"
+#include "PNGWriter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <unordered_set>
+
+using namespace std;
+
+namespace svg
+{
+    // Implementation for GridIndex
+    GridIndex::GridIndex() : cell_size(1), columns(0), rows(0) {}
+
+    void GridIndex::build(const vector<BoundingBox>& boxes, const Point& dimensions) {
+        bounds.clear();
+        cell_start.clear();
+        entries.clear();
+        big.clear();
+        columns = rows = 0;
+        if (dimensions.x <= 0 || dimensions.y <= 0) {
+            return;
+        }
+        BoundingBox area = {{0, 0}, {dimensions.x - 1, dimensions.y - 1}};
+
+        // Aim for about one element per cell, with at most ~1M cells.
+        double pixels = (double) dimensions.x * dimensions.y;
+        double n = max<size_t>(boxes.size(), 1);
+        cell_size = max(16, (int) ceil(sqrt(pixels / n)));
+        cell_size = max(cell_size, (int) ceil(sqrt(pixels / (1 << 20))));
+        columns = (dimensions.x + cell_size - 1) / cell_size;
+        rows = (dimensions.y + cell_size - 1) / cell_size;
+
+        // Two passes: count entries per cell, then fill them in (CSR layout).
+        // Large boxes go to the big list, and are left empty in the grid.
+        bounds.reserve(boxes.size());
+        vector<bool> gridded(boxes.size(), false);
+        for (size_t i = 0; i < boxes.size(); i++) {
+            BoundingBox box = boxes[i].intersection(area);
+            bounds.push_back(box);
+            if (box.empty()) {
+                continue;
+            }
+            size_t cells = (size_t) (box.max.x / cell_size - box.min.x / cell_size + 1) *
+                           (size_t) (box.max.y / cell_size - box.min.y / cell_size + 1);
+            if (cells > MAX_CELLS_PER_BOX) {
+                big.push_back(i);
+            } else {
+                gridded[i] = true;
+            }
+        }
+        cell_start.assign((size_t) columns * rows + 1, 0);
+        for (size_t i = 0; i < bounds.size(); i++) {
+            const BoundingBox& box = bounds[i];
+            if (!gridded[i]) {
+                continue;
+            }
+            for (int cy = box.min.y / cell_size; cy <= box.max.y / cell_size; cy++) {
+                for (int cx = box.min.x / cell_size; cx <= box.max.x / cell_size; cx++) {
+                    cell_start[(size_t) cy * columns + cx + 1]++;
+                }
+            }
+        }
+        for (size_t c = 1; c < cell_start.size(); c++) {
+            cell_start[c] += cell_start[c - 1];
+        }
+        entries.resize(cell_start.back());
+        vector<size_t> fill(cell_start.begin(), cell_start.end() - 1);
+        for (size_t i = 0; i < bounds.size(); i++) {
+            const BoundingBox& box = bounds[i];
+            if (!gridded[i]) {
+                continue;
+            }
+            for (int cy = box.min.y / cell_size; cy <= box.max.y / cell_size; cy++) {
+                for (int cx = box.min.x / cell_size; cx <= box.max.x / cell_size; cx++) {
+                    entries[fill[(size_t) cy * columns + cx]++] = i;
+                }
+            }
+        }
+    }
+
+    void GridIndex::query(const BoundingBox& region, vector<size_t>& result) const {
+        result.clear();
+        if (columns == 0) {
+            return;
+        }
+        BoundingBox area = {{0, 0}, {columns * cell_size - 1, rows * cell_size - 1}};
+        BoundingBox r = region.intersection(area);
+        if (r.empty()) {
+            return;
+        }
+        for (int cy = r.min.y / cell_size; cy <= r.max.y / cell_size; cy++) {
+            for (int cx = r.min.x / cell_size; cx <= r.max.x / cell_size; cx++) {
+                size_t c = (size_t) cy * columns + cx;
+                for (size_t e = cell_start[c]; e < cell_start[c + 1]; e++) {
+                    if (bounds[entries[e]].intersects(r)) {
+                        result.push_back(entries[e]);
+                    }
+                }
+            }
+        }
+        for (size_t i : big) {
+            if (bounds[i].intersects(r)) {
+                result.push_back(i);
+            }
+        }
+        // Boxes spanning several cells are found more than once.
+        sort(result.begin(), result.end());
+        result.erase(unique(result.begin(), result.end()), result.end());
+    }
+
+    // Implementation for RenderBudget
+    RenderBudget::RenderBudget()
+            : max_canvas_pixels(numeric_limits<uint64_t>::max()),
+              max_pixels_touched(numeric_limits<uint64_t>::max()),
+              max_vertices(numeric_limits<uint64_t>::max()),
+              max_bytes(numeric_limits<uint64_t>::max()),
+              action(REJECT) {}
+
+    // Implementation for BudgetExceeded
+    BudgetExceeded::BudgetExceeded(const string& what) : runtime_error(what) {}
+
+    // Implementation for RenderOptions
+    RenderOptions::RenderOptions() : cull_occluded(false), cancel(nullptr), parse_threads(1), indexed_png(false), storage(PixelStorage::Dense) {}
+
+    // Check if a point lies in a convex polygon (boundary included)
+    static bool insideConvex(const vector<Point>& outline, long long orientation, const Point& p) {
+        for (size_t i = 0; i < outline.size(); i++) {
+            Point a = outline[i], b = outline[(i + 1) % outline.size()];
+            long long cross = (long long) (b.x - a.x) * (p.y - a.y) - (long long) (b.y - a.y) * (p.x - a.x);
+            if ((orientation > 0 && cross < 0) || (orientation < 0 && cross > 0)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Implementation for Scene
+    Scene::Scene(const string& svg_file, const CancellationToken* cancel, unsigned threads) : index_built(false) {
+        try {
+            readSVG(svg_file, dims, svg_elements, cancel, threads);
+        } catch (...) {
+            // The destructor does not run for a partly constructed scene.
+            for (SVGElement* e : svg_elements) {
+                delete e;
+            }
+            throw;
+        }
+        for (const SVGElement* e : svg_elements) {
+            e->flatten(leaf_elements, leaf_owners, nullptr);
+        }
+        index_leaves();
+    }
+
+    void Scene::index_leaves() {
+        leaf_bounds.clear();
+        leaf_bounds.reserve(leaf_elements.size());
+        for (const SVGElement* e : leaf_elements) {
+            leaf_bounds.push_back(e->bounds());
+        }
+        lock_guard<mutex> lock(index_mutex);
+        index_built = false;
+    }
+
+    const GridIndex& Scene::spatial_index() const {
+        lock_guard<mutex> lock(index_mutex);
+        if (!index_built) {
+            index.build(leaf_bounds, dims);
+            index_built = true;
+        }
+        return index;
+    }
+
+    Scene::~Scene() {
+        for (SVGElement* e : svg_elements) {
+            delete e;
+        }
+    }
+
+    const Point& Scene::dimensions() const {
+        return dims;
+    }
+
+    const vector<SVGElement*>& Scene::elements() const {
+        return svg_elements;
+    }
+
+    const vector<const SVGElement*>& Scene::leaves() const {
+        return leaf_elements;
+    }
+
+    CostEstimate Scene::estimate_cost() const {
+        CostEstimate cost = {0, 0, 0, 0};
+        uint64_t w = max(dims.x, 0), h = max(dims.y, 0);
+        cost.canvas_pixels = w * h;
+        BoundingBox canvas = {{0, 0}, {dims.x - 1, dims.y - 1}};
+        for (size_t i = 0; i < leaf_elements.size(); i++) {
+            const BoundingBox& box = leaf_bounds[i];
+            if (box.empty()) {
+                continue;
+            }
+            BoundingBox visible = box.intersection(canvas);
+            if (!visible.empty()) {
+                cost.pixels_touched += (uint64_t) (visible.max.x - visible.min.x + 1) * (uint64_t) (visible.max.y - visible.min.y + 1);
+            }
+            cost.pixels_touched += max((int64_t) box.max.x - box.min.x, (int64_t) box.max.y - box.min.y) + 1;
+            if (leaf_elements[i]->opacity < 1 && !visible.empty()) {
+                // Copying the backdrop into a layer and blending it back
+                cost.pixels_touched += 2 * (uint64_t) (visible.max.x - visible.min.x + 1) * (uint64_t) (visible.max.y - visible.min.y + 1);
+            }
+            cost.vertices += leaf_elements[i]->vertexCount();
+        }
+        // The framebuffer comes from the pool (power-of-two capacity); the
+        // PNG encoder keeps the filtered rows and the compressed stream.
+        uint64_t capacity = 1;
+        while (capacity < cost.canvas_pixels) {
+            capacity <<= 1;
+        }
+        cost.peak_bytes = capacity * sizeof(Color) + 2 * (w * sizeof(Color) + 1) * h;
+        return cost;
+    }
+
+    bool Scene::palette(vector<Color>& colors) const {
+        Palette distinct;
+        distinct.add({255, 255, 255}); // Background
+        vector<Color> painted;
+        for (const SVGElement* leaf : leaf_elements) {
+            painted.clear();
+            if (!leaf->paintColors(painted)) {
+                return false;
+            }
+            for (const Color& c : painted) {
+                if (distinct.add(c) < 0) {
+                    return false;
+                }
+            }
+        }
+        colors = distinct.colors();
+        return true;
+    }
+
+    // Describe the first limit a cost exceeds, or return an empty string
+    static string overBudget(const CostEstimate& cost, const RenderBudget& budget) {
+        ostringstream what;
+        if (cost.canvas_pixels > budget.max_canvas_pixels) {
+            what << "canvas of " << cost.canvas_pixels << " pixels exceeds budget of " << budget.max_canvas_pixels;
+        } else if (cost.pixels_touched > budget.max_pixels_touched) {
+            what << "drawing touches " << cost.pixels_touched << " pixels, over budget of " << budget.max_pixels_touched;
+        } else if (cost.vertices > budget.max_vertices) {
+            what << cost.vertices << " vertices exceed budget of " << budget.max_vertices;
+        } else if (cost.peak_bytes > budget.max_bytes) {
+            what << "rendering needs " << cost.peak_bytes << " bytes, over budget of " << budget.max_bytes;
+        }
+        return what.str();
+    }
+
+    double Scene::admit(const RenderBudget& budget) {
+        if (dims.x <= 0 || dims.y <= 0) {
+            ostringstream what;
+            what << "empty canvas of " << dims.x << "x" << dims.y << " pixels";
+            throw BudgetExceeded(what.str());
+        }
+        CostEstimate cost = estimate_cost();
+        string what = overBudget(cost, budget);
+        if (what.empty()) {
+            return 1;
+        }
+        if (budget.action == RenderBudget::REJECT || cost.vertices > budget.max_vertices) {
+            throw BudgetExceeded(what);
+        }
+        // Areas shrink with the square of the factor; rounding and the
+        // outline term may leave the scene slightly over, so retry a few times.
+        double total = 1;
+        for (int attempt = 0; attempt < 4 && !what.empty(); attempt++) {
+            double factor = 1;
+            if (cost.canvas_pixels > budget.max_canvas_pixels) {
+                factor = min(factor, sqrt((double) budget.max_canvas_pixels / cost.canvas_pixels));
+            }
+            if (cost.pixels_touched > budget.max_pixels_touched) {
+                factor = min(factor, sqrt((double) budget.max_pixels_touched / cost.pixels_touched));
+            }
+            if (cost.peak_bytes > budget.max_bytes) {
+                factor = min(factor, sqrt((double) budget.max_bytes / cost.peak_bytes));
+            }
+            factor *= 0.99;
+            zoom(factor);
+            total *= factor;
+            cost = estimate_cost();
+            what = overBudget(cost, budget);
+        }
+        if (!what.empty()) {
+            throw BudgetExceeded(what);
+        }
+        return total;
+    }
+
+    void Scene::zoom(double factor) {
+        for (SVGElement* e : svg_elements) {
+            e->zoom(factor);
+        }
+        dims = {max(1, (int) (dims.x * factor)), max(1, (int) (dims.y * factor))};
+        index_leaves();
+    }
+
+    void Scene::draw(PNGImage& img) const {
+        for (const SVGElement* e : svg_elements) {
+            e->render(img);
+        }
+    }
+
+    // Installs a cancellation token on an image for the duration of a scope
+    struct CancellationScope {
+        PNGImage& img;
+        CancellationScope(PNGImage& img, const CancellationToken* token) : img(img) {
+            img.set_cancellation(token);
+        }
+        ~CancellationScope() {
+            img.set_cancellation(nullptr);
+        }
+    };
+
+    void Scene::draw(PNGImage& img, const RenderOptions& options) const {
+        if (!options.cull_occluded && options.cancel == nullptr) {
+            draw(img);
+            return;
+        }
+        CancellationScope scope(img, options.cancel);
+        if (options.cull_occluded) {
+            for (size_t i : unoccluded_leaves()) {
+                check_cancelled(options.cancel);
+                leaf_elements[i]->render(img);
+            }
+            return;
+        }
+        for (const SVGElement* e : leaf_elements) {
+            check_cancelled(options.cancel);
+            e->render(img);
+        }
+    }
+
+    vector<size_t> Scene::unoccluded_leaves() const {
+        const int tile = 16;
+        int columns = (dims.x + tile - 1) / tile, rows = (dims.y + tile - 1) / tile;
+        BoundingBox canvas = {{0, 0}, {dims.x - 1, dims.y - 1}};
+        vector<char> covered((size_t) max(columns, 0) * max(rows, 0), 0);
+        vector<size_t> kept;
+        vector<Point> outline;
+        for (size_t i = leaf_elements.size(); i-- > 0;) {
+            BoundingBox box = leaf_bounds[i].intersection(canvas);
+            if (box.empty()) {
+                continue;
+            }
+            int tx0 = box.min.x / tile, tx1 = box.max.x / tile;
+            int ty0 = box.min.y / tile, ty1 = box.max.y / tile;
+            bool hidden = true;
+            for (int ty = ty0; ty <= ty1 && hidden; ty++) {
+                for (int tx = tx0; tx <= tx1 && hidden; tx++) {
+                    hidden = covered[(size_t) ty * columns + tx] != 0;
+                }
+            }
+            if (hidden) {
+                continue;
+            }
+            kept.push_back(i);
+            // Translucent elements let the elements below show through
+            if (leaf_elements[i]->opacity < 1 || !leaf_elements[i]->occluder(outline)) {
+                continue;
+            }
+            long long orientation = 0;
+            for (size_t k = 0; k < outline.size(); k++) {
+                Point a = outline[k], b = outline[(k + 1) % outline.size()];
+                orientation += (long long) a.x * b.y - (long long) b.x * a.y;
+            }
+            // A tile is painted by the fill spans if the tile grown by one
+            // pixel lies inside the polygon: rows are then strictly between
+            // the top and bottom vertices, and each span reaches past the tile.
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++) {
+                    char& c = covered[(size_t) ty * columns + tx];
+                    if (c) {
+                        continue;
+                    }
+                    int x0 = tx * tile - 1, x1 = min(tx * tile + tile, dims.x);
+                    int y0 = ty * tile - 1, y1 = min(ty * tile + tile, dims.y);
+                    c = insideConvex(outline, orientation, {x0, y0}) &&
+                        insideConvex(outline, orientation, {x1, y0}) &&
+                        insideConvex(outline, orientation, {x0, y1}) &&
+                        insideConvex(outline, orientation, {x1, y1});
+                }
+            }
+        }
+        reverse(kept.begin(), kept.end());
+        return kept;
+    }
+
+    unique_ptr<PNGImage> Scene::render_region(int x, int y, int w, int h) const {
+        auto img = make_unique<PNGImage>(w, h);
+        img->set_origin({x, y});
+        vector<size_t> visible;
+        spatial_index().query({{x, y}, {x + w - 1, y + h - 1}}, visible);
+        for (size_t i : visible) {
+            leaf_elements[i]->render(*img);
+        }
+        return img;
+    }
+
+    string Scene::element_at(int x, int y) const {
+        BoundingBox pixel = {{x, y}, {x, y}};
+        vector<size_t> candidates;
+        spatial_index().query(pixel, candidates);
+        for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+            if (leaf_elements[*it]->paints(pixel)) {
+                const SVGElement* owner = leaf_owners[*it];
+                return owner ? owner->id : "";
+            }
+        }
+        return "";
+    }
+
+    vector<string> Scene::elements_in_rect(int x, int y, int w, int h) const {
+        // Nothing is painted outside the canvas.
+        BoundingBox canvas = {{0, 0}, {dims.x - 1, dims.y - 1}};
+        BoundingBox region = BoundingBox{{x, y}, {x + w - 1, y + h - 1}}.intersection(canvas);
+        vector<size_t> candidates;
+        spatial_index().query(region, candidates);
+        vector<string> ids;
+        unordered_set<const SVGElement*> seen;
+        for (size_t i : candidates) {
+            const SVGElement* owner = leaf_owners[i];
+            if (owner == nullptr || seen.count(owner) != 0) {
+                continue;
+            }
+            if (leaf_elements[i]->paints(region)) {
+                seen.insert(owner);
+                ids.push_back(owner->id);
+            }
+        }
+        return ids;
+    }
+}
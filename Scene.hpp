@@ -0,0 +1,260 @@
+#ifndef __svg_Scene_hpp__
+#define __svg_Scene_hpp__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "SVGElements.hpp"
+
+namespace svg
+{
+    /**
+     * @brief Uniform grid over bounding boxes, for region queries.
+     *
+     * Boxes covering more than MAX_CELLS_PER_BOX cells are kept in a separate list
+     * checked by every query, so that the storage stays proportional to the number
+     * of boxes however large they are.
+     */
+    class GridIndex
+    {
+    public:
+        GridIndex(); ///< Constructor of empty index.
+        /**
+         * @brief Builds the index.
+         * @param boxes The boxes to index; the result of a query are indices into this vector.
+         * @param dimensions The size of the indexed area; boxes are clipped to it.
+         */
+        void build(const std::vector<BoundingBox> &boxes, const Point &dimensions);
+        /**
+         * @brief Finds the boxes that may intersect a region.
+         * @param region The region.
+         * @param result The vector to store indices of matching boxes, in ascending order.
+         */
+        void query(const BoundingBox &region, std::vector<size_t> &result) const;
+
+    private:
+        static const size_t MAX_CELLS_PER_BOX = 64; ///< The most cells a box is entered in.
+
+        int cell_size; ///< The width and height of a grid cell.
+        int columns; ///< The number of grid columns.
+        int rows; ///< The number of grid rows.
+        std::vector<BoundingBox> bounds; ///< The indexed boxes, clipped to the indexed area.
+        std::vector<size_t> cell_start; ///< Start of each cell's entries (one extra at the end).
+        std::vector<size_t> entries; ///< Box indices, grouped by cell.
+        std::vector<size_t> big; ///< Indices of the boxes covering too many cells to be entered in them.
+    };
+
+    /**
+     * @brief Estimated cost of rendering a scene, computed without rasterizing.
+     */
+    struct CostEstimate
+    {
+        uint64_t canvas_pixels; ///< The number of pixels of the canvas.
+        uint64_t pixels_touched; ///< The pixels visited by drawing, summed over all primitive elements.
+        uint64_t vertices; ///< The number of polygon, polyline and line vertices.
+        uint64_t peak_bytes; ///< The memory needed to draw and encode the image.
+    };
+
+    /**
+     * @brief Limits on the cost of rendering a scene.
+     */
+    struct RenderBudget
+    {
+        /**
+         * @brief What to do with a scene over budget.
+         */
+        enum Action
+        {
+            REJECT,   ///< Throw BudgetExceeded.
+            DOWNSCALE ///< Scale the scene down until it fits (vertex limits still reject).
+        };
+        RenderBudget(); ///< Constructor of an unlimited budget.
+        uint64_t max_canvas_pixels; ///< The maximum canvas size in pixels.
+        uint64_t max_pixels_touched; ///< The maximum pixels visited by drawing.
+        uint64_t max_vertices; ///< The maximum number of vertices.
+        uint64_t max_bytes; ///< The maximum memory to draw and encode.
+        Action action; ///< What to do with a scene over budget (default REJECT).
+    };
+
+    /**
+     * @brief Error thrown when a scene exceeds its render budget.
+     */
+    class BudgetExceeded : public std::runtime_error
+    {
+    public:
+        /**
+         * @brief Constructs the error.
+         * @param what The description of the exceeded limit.
+         */
+        explicit BudgetExceeded(const std::string &what);
+    };
+
+    /**
+     * @brief Options for rendering a scene.
+     */
+    struct RenderOptions
+    {
+        RenderOptions(); ///< Constructor of default options.
+        bool cull_occluded; ///< Skip elements hidden by later opaque convex shapes (default false).
+        RenderBudget budget; ///< Limits checked before the framebuffer is allocated (default unlimited).
+        const CancellationToken *cancel; ///< Token polled while parsing and drawing, or nullptr (default).
+        unsigned parse_threads; ///< Threads parsing the top-level elements of a document (default 1).
+        bool indexed_png; ///< Save images with at most 256 colors as indexed-color PNG (default false).
+        PixelStorage storage; ///< Pixel storage of the framebuffer; only dense storage uses the framebuffer pool (default Dense).
+    };
+
+    /**
+     * @brief A parsed SVG document, with its elements indexed by position.
+     */
+    class Scene
+    {
+    public:
+        /**
+         * @brief Constructs a scene by reading an SVG file.
+         * @param svg_file The path to the SVG file.
+         * @param cancel The token polled while parsing, or nullptr.
+         * @param threads The number of threads parsing top-level elements (see readSVG()).
+         * @throw RenderCancelled if the token fires; elements parsed so far are freed.
+         */
+        explicit Scene(const std::string &svg_file, const CancellationToken *cancel = nullptr, unsigned threads = 1);
+        ~Scene(); ///< Destructor.
+        Scene(const Scene &) = delete;
+        Scene &operator=(const Scene &) = delete;
+
+        /**
+         * @brief Gets the dimensions of the document.
+         * @return The document width and height.
+         */
+        const Point &dimensions() const;
+        /**
+         * @brief Gets the top-level elements of the document.
+         * @return The elements.
+         */
+        const std::vector<SVGElement *> &elements() const;
+        /**
+         * @brief Gets the primitive elements of the document, in paint order.
+         * @return The elements.
+         */
+        const std::vector<const SVGElement *> &leaves() const;
+        /**
+         * @brief Estimates the cost of rendering the document.
+         *
+         * Pixels touched are the bounding-box area of each primitive element
+         * clipped to the canvas, plus the length of its unclipped outline
+         * (lines are stepped pixel by pixel even off-canvas).
+         * @return The estimate.
+         */
+        CostEstimate estimate_cost() const;
+        /**
+         * @brief Gets the colors of the drawn document, known from its elements before drawing.
+         * @param colors The vector to store the colors, the white background first.
+         * @return true if the drawn document has only these colors, at most 256; false if
+         *         some element is painted with a gradient or translucent, or there are more.
+         */
+        bool palette(std::vector<Color> &colors) const;
+        /**
+         * @brief Checks the document against a budget, scaling it down if allowed.
+         * @param budget The budget.
+         * @return The scaling factor applied (1 if the document fits).
+         * @throw BudgetExceeded if the canvas is empty, or the document does not fit and
+         *        cannot be scaled to fit.
+         */
+        double admit(const RenderBudget &budget);
+        /**
+         * @brief Scales the document, canvas included, around the origin.
+         * @param factor The scaling factor.
+         */
+        void zoom(double factor);
+        /**
+         * @brief Draws the whole document.
+         * @param img The image to draw on.
+         */
+        void draw(PNGImage &img) const;
+        /**
+         * @brief Draws the whole document.
+         *
+         * If options.cancel is set, it is polled before each primitive element and
+         * by the scanline loops, and RenderCancelled is thrown once it fires.
+         * @param img The image to draw on.
+         * @param options The rendering options.
+         */
+        void draw(PNGImage &img, const RenderOptions &options) const;
+        /**
+         * @brief Finds the primitive elements not hidden by later opaque convex shapes.
+         *
+         * Runs back to front over the paint order, keeping a coverage mask of
+         * 16x16 tiles; an element is dropped if every tile its bounding box
+         * touches is fully painted by later occluders. Drawing the remaining
+         * elements gives the same image as drawing all of them.
+         * @return Indices into leaves() of the elements to draw, in paint order.
+         */
+        std::vector<size_t> unoccluded_leaves() const;
+        /**
+         * @brief Renders a region of the document, visiting only the elements that intersect it.
+         * @param x The X position of the region.
+         * @param y The Y position of the region.
+         * @param w The width of the region.
+         * @param h The height of the region.
+         * @return An image of size w x h holding the region.
+         */
+        std::unique_ptr<PNGImage> render_region(int x, int y, int w, int h) const;
+        /**
+         * @brief Finds the topmost element painting a pixel.
+         *
+         * Elements without an id are reported by the id of the innermost group containing them.
+         * @param x The X position of the pixel.
+         * @param y The Y position of the pixel.
+         * @return The id of the element, or an empty string if no element paints the pixel
+         *         (or it has no id).
+         */
+        std::string element_at(int x, int y) const;
+        /**
+         * @brief Finds the elements painting at least one pixel of a region.
+         * @param x The X position of the region.
+         * @param y The Y position of the region.
+         * @param w The width of the region.
+         * @param h The height of the region.
+         * @return The ids of the elements, in paint order and without repetitions
+         *         (elements without an id are reported as in element_at()).
+         */
+        std::vector<std::string> elements_in_rect(int x, int y, int w, int h) const;
+
+    private:
+        /**
+         * @brief Recomputes leaf_bounds and drops the spatial index.
+         */
+        void index_leaves();
+        /**
+         * @brief Gets the spatial index, building it on first use.
+         *
+         * Only region queries need it, so documents that are just drawn (or
+         * rejected by admit()) never pay for it.
+         * @return The index.
+         */
+        const GridIndex &spatial_index() const;
+
+        Point dims; ///< The dimensions of the document.
+        std::vector<SVGElement *> svg_elements; ///< The top-level elements (owned).
+        std::vector<const SVGElement *> leaf_elements; ///< The primitive elements, in paint order.
+        std::vector<const SVGElement *> leaf_owners; ///< The element whose id reports each primitive element.
+        std::vector<BoundingBox> leaf_bounds; ///< The bounding box of each primitive element.
+        mutable GridIndex index; ///< Spatial index over leaf_bounds, built by spatial_index().
+        mutable bool index_built; ///< Whether index is up to date.
+        mutable std::mutex index_mutex; ///< Guards the lazy build of index.
+    };
+
+    /**
+     * @brief Converts an SVG file to a PNG file.
+     * @param svg_file The path to the SVG file.
+     * @param png_file The path to the PNG file.
+     * @param options The rendering options.
+     */
+    void convert(const std::string &svg_file,
+                 const std::string &png_file,
+                 const RenderOptions &options);
+}
+
+#endif
@@ -0,0 +1,314 @@
+//! @file Stroke.cpp
+#include "Stroke.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+namespace svg
+{
+    // Tolerance for points lying exactly on a piece boundary.
+    static const double EPS = 1e-9;
+    // Largest stroke width and miter limit read from documents, which
+    // keep margin() and the outline arithmetic well within int range.
+    static const double MAX_STROKE_WIDTH = 100000;
+    static const double MAX_MITER_LIMIT = 100;
+
+    StrokeStyle::StrokeStyle()
+        : width(1), join(LineJoin::Miter), cap(LineCap::Butt), miter_limit(4)
+    {
+    }
+
+    bool StrokeStyle::thin() const
+    {
+        return width <= 1;
+    }
+
+    int StrokeStyle::margin() const
+    {
+        if (thin())
+        {
+            return 0;
+        }
+        // Square caps reach half the width diagonally; miters up to
+        // miter_limit half-widths.
+        double factor = M_SQRT2;
+        if (join == LineJoin::Miter)
+        {
+            factor = std::max(factor, miter_limit);
+        }
+        // NaN fails the comparison too.
+        double margin = width / 2 * factor;
+        if (!(margin <= MAX_STROKE_WIDTH / 2 * MAX_MITER_LIMIT))
+        {
+            margin = MAX_STROKE_WIDTH / 2 * MAX_MITER_LIMIT;
+        }
+        return (int)::ceil(margin) + 1;
+    }
+
+    LineJoin parse_line_join(const std::string &str)
+    {
+        if (str == "round")
+        {
+            return LineJoin::Round;
+        }
+        if (str == "bevel")
+        {
+            return LineJoin::Bevel;
+        }
+        return LineJoin::Miter;
+    }
+
+    LineCap parse_line_cap(const std::string &str)
+    {
+        if (str == "round")
+        {
+            return LineCap::Round;
+        }
+        if (str == "square")
+        {
+            return LineCap::Square;
+        }
+        return LineCap::Butt;
+    }
+
+    double parse_stroke_width(const std::string &str)
+    {
+        double width = std::strtod(str.c_str(), nullptr);
+        if (!std::isfinite(width) || width < 0)
+        {
+            return 1;
+        }
+        return std::min(width, MAX_STROKE_WIDTH);
+    }
+
+    double parse_miter_limit(const std::string &str)
+    {
+        double limit = std::strtod(str.c_str(), nullptr);
+        if (!std::isfinite(limit) || limit < 1)
+        {
+            return 4;
+        }
+        return std::min(limit, MAX_MITER_LIMIT);
+    }
+
+    StrokeOutline::StrokeOutline(const std::vector<Point> &points, const StrokeStyle &style)
+        : next_(0), row_(INT_MIN)
+    {
+        std::vector<Point> p;
+        for (const Point &q : points)
+        {
+            if (p.empty() || q.x != p.back().x || q.y != p.back().y)
+            {
+                p.push_back(q);
+            }
+        }
+        double hw = style.width / 2;
+        if (p.size() == 1)
+        {
+            // Zero-length polyline: only round and square caps are visible.
+            if (style.cap == LineCap::Round)
+            {
+                add_disk(p[0].x, p[0].y, hw);
+            }
+            else if (style.cap == LineCap::Square)
+            {
+                double xs[] = {p[0].x - hw, p[0].x + hw, p[0].x + hw, p[0].x - hw};
+                double ys[] = {p[0].y - hw, p[0].y - hw, p[0].y + hw, p[0].y + hw};
+                add_polygon(xs, ys, 4);
+            }
+        }
+        size_t m = p.size();
+        std::vector<double> dx(m), dy(m);
+        for (size_t i = 0; i + 1 < m; i++)
+        {
+            // Segment body, extended by half the width for square caps.
+            double len = ::hypot(p[i + 1].x - p[i].x, p[i + 1].y - p[i].y);
+            dx[i] = (p[i + 1].x - p[i].x) / len;
+            dy[i] = (p[i + 1].y - p[i].y) / len;
+            double ax = p[i].x, ay = p[i].y, bx = p[i + 1].x, by = p[i + 1].y;
+            if (style.cap == LineCap::Square && i == 0)
+            {
+                ax -= dx[i] * hw;
+                ay -= dy[i] * hw;
+            }
+            if (style.cap == LineCap::Square && i + 2 == m)
+            {
+                bx += dx[i] * hw;
+                by += dy[i] * hw;
+            }
+            double nx = -dy[i] * hw, ny = dx[i] * hw;
+            double xs[] = {ax + nx, bx + nx, bx - nx, ax - nx};
+            double ys[] = {ay + ny, by + ny, by - ny, ay - ny};
+            add_polygon(xs, ys, 4);
+        }
+        for (size_t i = 1; i + 1 < m; i++)
+        {
+            double vx = p[i].x, vy = p[i].y;
+            if (style.join == LineJoin::Round)
+            {
+                add_disk(vx, vy, hw);
+                continue;
+            }
+            double cross = dx[i - 1] * dy[i] - dy[i - 1] * dx[i];
+            double dot = dx[i - 1] * dx[i] + dy[i - 1] * dy[i];
+            if (::fabs(cross) < EPS && dot > 0)
+            {
+                continue;
+            }
+            // The outer corner lies against the turn direction.
+            double s = cross > 0 ? -hw : hw;
+            double n1x = -dy[i - 1], n1y = dx[i - 1], n2x = -dy[i], n2y = dx[i];
+            double o1x = vx + s * n1x, o1y = vy + s * n1y;
+            double o2x = vx + s * n2x, o2y = vy + s * n2y;
+            double sx = n1x + n2x, sy = n1y + n2y, len2 = sx * sx + sy * sy;
+            if (style.join == LineJoin::Miter && len2 > EPS && 2 / ::sqrt(len2) <= style.miter_limit)
+            {
+                double tx = vx + s * sx * 2 / len2, ty = vy + s * sy * 2 / len2;
+                double xs[] = {vx, o1x, tx, o2x};
+                double ys[] = {vy, o1y, ty, o2y};
+                add_polygon(xs, ys, 4);
+            }
+            else
+            {
+                double xs[] = {vx, o1x, o2x};
+                double ys[] = {vy, o1y, o2y};
+                add_polygon(xs, ys, 3);
+            }
+        }
+        if (style.cap == LineCap::Round && m > 1)
+        {
+            add_disk(p[0].x, p[0].y, hw);
+            add_disk(p[m - 1].x, p[m - 1].y, hw);
+        }
+        std::sort(pieces_.begin(), pieces_.end(),
+                  [](const Piece &a, const Piece &b)
+                  { return a.top < b.top; });
+    }
+
+    void StrokeOutline::add_polygon(const double *xs, const double *ys, int n)
+    {
+        Piece piece;
+        piece.n = n;
+        piece.r = 0;
+        double y_min = ys[0], y_max = ys[0];
+        for (int i = 0; i < n; i++)
+        {
+            piece.x[i] = xs[i];
+            piece.y[i] = ys[i];
+            y_min = std::min(y_min, ys[i]);
+            y_max = std::max(y_max, ys[i]);
+        }
+        piece.top = (int)::ceil(y_min - EPS);
+        piece.bottom = (int)::floor(y_max + EPS);
+        pieces_.push_back(piece);
+    }
+
+    void StrokeOutline::add_disk(double cx, double cy, double r)
+    {
+        Piece piece;
+        piece.n = 0;
+        piece.x[0] = cx;
+        piece.y[0] = cy;
+        piece.r = r;
+        piece.top = (int)::ceil(cy - r - EPS);
+        piece.bottom = (int)::floor(cy + r + EPS);
+        pieces_.push_back(piece);
+    }
+
+    BoundingBox StrokeOutline::bounds() const
+    {
+        BoundingBox box = {{0, 0}, {-1, -1}};
+        for (const Piece &piece : pieces_)
+        {
+            double x_min = piece.x[0] - piece.r, x_max = piece.x[0] + piece.r;
+            for (int i = 1; i < piece.n; i++)
+            {
+                x_min = std::min(x_min, piece.x[i]);
+                x_max = std::max(x_max, piece.x[i]);
+            }
+            box = box.merge({{(int)::floor(x_min), piece.top}, {(int)::ceil(x_max), piece.bottom}});
+        }
+        return box;
+    }
+
+    void StrokeOutline::row_spans(int y, std::vector<Point> &spans)
+    {
+        spans.clear();
+        if (y < row_)
+        {
+            active_.clear();
+            next_ = 0;
+        }
+        row_ = y;
+        while (next_ < pieces_.size() && pieces_[next_].top <= y)
+        {
+            active_.push_back(next_++);
+        }
+        intervals_.clear();
+        size_t kept = 0;
+        for (size_t a : active_)
+        {
+            const Piece &piece = pieces_[a];
+            if (piece.bottom < y)
+            {
+                continue;
+            }
+            active_[kept++] = a;
+            double x_min, x_max;
+            if (piece.n == 0)
+            {
+                double d = y - piece.y[0];
+                double h = ::sqrt(std::max(0.0, piece.r * piece.r - d * d));
+                x_min = piece.x[0] - h;
+                x_max = piece.x[0] + h;
+            }
+            else
+            {
+                // Convex polygon: the row crosses its boundary in one interval.
+                x_min = HUGE_VAL;
+                x_max = -HUGE_VAL;
+                for (int i = 0; i < piece.n; i++)
+                {
+                    double px = piece.x[i], py = piece.y[i];
+                    double qx = piece.x[(i + 1) % piece.n], qy = piece.y[(i + 1) % piece.n];
+                    if (y < std::min(py, qy) - EPS || y > std::max(py, qy) + EPS)
+                    {
+                        continue;
+                    }
+                    if (::fabs(qy - py) < EPS)
+                    {
+                        x_min = std::min(x_min, std::min(px, qx));
+                        x_max = std::max(x_max, std::max(px, qx));
+                        continue;
+                    }
+                    double t = std::min(1.0, std::max(0.0, (y - py) / (qy - py)));
+                    double x = px + t * (qx - px);
+                    x_min = std::min(x_min, x);
+                    x_max = std::max(x_max, x);
+                }
+            }
+            int x0 = (int)::ceil(x_min - EPS), x1 = (int)::floor(x_max + EPS);
+            if (x0 <= x1)
+            {
+                intervals_.push_back({x0, x1});
+            }
+        }
+        active_.resize(kept);
+        std::sort(intervals_.begin(), intervals_.end(),
+                  [](const Point &a, const Point &b)
+                  { return a.x < b.x; });
+        for (const Point &iv : intervals_)
+        {
+            if (!spans.empty() && iv.x <= spans.back().y + 1)
+            {
+                spans.back().y = std::max(spans.back().y, iv.y);
+            }
+            else
+            {
+                spans.push_back(iv);
+            }
+        }
+    }
+}
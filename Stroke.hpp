@@ -0,0 +1,122 @@
+//! @file Stroke.hpp
+#ifndef __svg_Stroke_hpp__
+#define __svg_Stroke_hpp__
+
+#include "Point.hpp"
+
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Shape of the corners between polyline segments.
+    enum class LineJoin
+    {
+        Miter,
+        Round,
+        Bevel
+    };
+
+    //! Shape of the ends of a polyline.
+    enum class LineCap
+    {
+        Butt,
+        Round,
+        Square
+    };
+
+    //! Stroke parameters (SVG defaults: width 1, miter joins,
+    //! butt caps, miter limit 4).
+    struct StrokeStyle
+    {
+        //! Constructor of default style.
+        StrokeStyle();
+        //! Stroke width; widths up to 1 are drawn as 1-pixel lines.
+        double width;
+        //! Join shape.
+        LineJoin join;
+        //! Cap shape.
+        LineCap cap;
+        //! Limit on the ratio between miter length and stroke width,
+        //! beyond which miter joins are drawn as bevels.
+        double miter_limit;
+
+        //! Check if the stroke is drawn with 1-pixel lines.
+        //! @return true if width is at most 1.
+        bool thin() const;
+        //! Distance the stroke may extend beyond the polyline vertices.
+        //! @return Margin in pixels.
+        int margin() const;
+    };
+
+    //! Parse a stroke-linejoin value ("miter", "round" or "bevel").
+    //! @param str String.
+    //! @return The join (Miter for unknown values).
+    LineJoin parse_line_join(const std::string &str);
+    //! Parse a stroke-linecap value ("butt", "round" or "square").
+    //! @param str String.
+    //! @return The cap (Butt for unknown values).
+    LineCap parse_line_cap(const std::string &str);
+    //! Parse a stroke-width value; units are ignored.
+    //! @param str String.
+    //! @return The width, at most 100000 (1 for negative or non-finite
+    //! values).
+    double parse_stroke_width(const std::string &str);
+    //! Parse a stroke-miterlimit value.
+    //! @param str String.
+    //! @return The limit, at most 100 (4 for values below 1 or
+    //! non-finite values).
+    double parse_miter_limit(const std::string &str);
+
+    //! Area covered by a wide polyline stroke, as a set of convex
+    //! pieces (segment bodies, joins and caps) whose union is
+    //! scanned row by row. Pixel (x, y) is covered if the point
+    //! (x, y) lies in some piece.
+    class StrokeOutline
+    {
+    public:
+        //! Constructor.
+        //! @param points Polyline vertices.
+        //! @param style Stroke style.
+        StrokeOutline(const std::vector<Point> &points, const StrokeStyle &style);
+        //! Get the rows covered by the stroke.
+        //! @return Box of covered pixels (may be slightly larger).
+        BoundingBox bounds() const;
+        //! Compute the covered spans of a row, merged so that each pixel
+        //! appears once. Fastest when called for increasing rows.
+        //! @param y Y position.
+        //! @param spans Output spans, each given as a point (first X, last X),
+        //!              sorted and disjoint.
+        void row_spans(int y, std::vector<Point> &spans);
+
+    private:
+        //! Convex polygon or disk.
+        struct Piece
+        {
+            //! Polygon vertices (n of them), or disk center at x[0], y[0].
+            double x[4], y[4];
+            //! Number of polygon vertices; 0 for a disk.
+            int n;
+            //! Disk radius.
+            double r;
+            //! First and last row the piece may cover.
+            int top, bottom;
+        };
+        //! Add a polygon piece.
+        void add_polygon(const double *xs, const double *ys, int n);
+        //! Add a disk piece.
+        void add_disk(double cx, double cy, double r);
+
+        //! Pieces, sorted by top row after construction.
+        std::vector<Piece> pieces_;
+        //! Indices of pieces that may cover the current row.
+        std::vector<size_t> active_;
+        //! Next piece to activate.
+        size_t next_;
+        //! Last row passed to row_spans.
+        int row_;
+        //! Scratch intervals.
+        std::vector<Point> intervals_;
+    };
+}
+#endif
@@ -0,0 +1,277 @@
+#include "Style.hpp"
+#include "Hash.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+using namespace std;
+
+namespace svg
+{
+    static const char* const PROPERTY_NAMES[STYLE_PROPERTY_COUNT] = {
+        "fill", "stroke", "stroke-width", "stroke-linejoin", "stroke-linecap", "stroke-miterlimit",
+        "fill-opacity", "stroke-opacity", "opacity", "fill-rule"};
+
+    // Check if a property takes the value of the parent element when not set
+    static bool isInherited(int property) {
+        return property != OPACITY;
+    }
+
+    // Remove leading and trailing whitespace
+    static string trim(const string& s, size_t begin, size_t end) {
+        while (begin < end && isspace((unsigned char) s[begin])) {
+            begin++;
+        }
+        while (end > begin && isspace((unsigned char) s[end - 1])) {
+            end--;
+        }
+        return s.substr(begin, end - begin);
+    }
+
+    // Check if a selector name consists of identifier characters only
+    static bool isSimpleName(const string& name) {
+        if (name.empty()) {
+            return false;
+        }
+        for (char c : name) {
+            if (!isalnum((unsigned char) c) && c != '-' && c != '_') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    StyleProperty find_style_property(const string& name) {
+        for (int p = 0; p < STYLE_PROPERTY_COUNT; p++) {
+            if (name == PROPERTY_NAMES[p]) {
+                return (StyleProperty) p;
+            }
+        }
+        return STYLE_PROPERTY_COUNT;
+    }
+
+    double parse_opacity(const string& value) {
+        if (value.empty()) {
+            return 1;
+        }
+        char* end;
+        double opacity = strtod(value.c_str(), &end);
+        if (*end == '%') {
+            opacity /= 100;
+        }
+        return max(0.0, min(1.0, opacity));
+    }
+
+    void parse_declarations(const string& text, Declarations& declarations) {
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t end = text.find(';', begin);
+            if (end == string::npos) {
+                end = text.size();
+            }
+            size_t colon = text.find(':', begin);
+            if (colon < end) {
+                StyleProperty property = find_style_property(trim(text, begin, colon));
+                if (property != STYLE_PROPERTY_COUNT) {
+                    string value = trim(text, colon + 1, end);
+                    size_t important = value.find("!important");
+                    if (important != string::npos) {
+                        value = trim(value, 0, important);
+                    }
+                    declarations.push_back({property, value});
+                }
+            }
+            begin = end + 1;
+        }
+    }
+
+    // Implementation for ComputedStyle
+    const string& ComputedStyle::get(StyleProperty property) const {
+        return values[property];
+    }
+
+    void ComputedStyle::apply(const Declarations& declarations, const ComputedStyle& parent) {
+        for (const Declaration& d : declarations) {
+            values[d.property] = d.value == "inherit" ? parent.values[d.property] : d.value;
+        }
+    }
+
+    bool ComputedStyle::operator==(const ComputedStyle& other) const {
+        return equal(values, values + STYLE_PROPERTY_COUNT, other.values);
+    }
+
+    // Implementation for StyleSheet
+    void StyleSheet::parse(const string& css) {
+        // Drop comments
+        string text;
+        for (size_t i = 0; i < css.size();) {
+            if (css.compare(i, 2, "/*") == 0) {
+                size_t end = css.find("*/", i + 2);
+                i = end == string::npos ? css.size() : end + 2;
+            } else {
+                text += css[i++];
+            }
+        }
+
+        size_t begin = 0;
+        while (true) {
+            size_t open = text.find('{', begin);
+            size_t close = text.find('}', open);
+            if (open == string::npos || close == string::npos) {
+                break;
+            }
+            Declarations declarations;
+            parse_declarations(text.substr(open + 1, close - open - 1), declarations);
+            size_t rule = rules.size();
+            rules.push_back(declarations);
+
+            // Index the rule under each simple selector of the group
+            string selectors = text.substr(begin, open - begin);
+            size_t s = 0;
+            while (s <= selectors.size()) {
+                size_t comma = min(selectors.find(',', s), selectors.size());
+                string selector = trim(selectors, s, comma);
+                s = comma + 1;
+                if (selector.size() < 2 || !isSimpleName(selector.substr(1))) {
+                    continue;
+                }
+                IdTable* table = selector[0] == '.' ? &classes : selector[0] == '#' ? &ids : nullptr;
+                if (table == nullptr) {
+                    continue;
+                }
+                vector<vector<size_t>>& index = table == &classes ? rules_by_class : rules_by_id;
+                uint32_t symbol = table->intern(selector.substr(1));
+                if (index.size() <= symbol) {
+                    index.resize(symbol + 1);
+                }
+                if (index[symbol].empty() || index[symbol].back() != rule) {
+                    index[symbol].push_back(rule);
+                }
+            }
+            begin = close + 1;
+        }
+    }
+
+    bool StyleSheet::empty() const {
+        return rules.empty();
+    }
+
+    const vector<size_t>* StyleSheet::class_rules(const string& name) const {
+        uint32_t symbol = classes.find(name);
+        return symbol < rules_by_class.size() ? &rules_by_class[symbol] : nullptr;
+    }
+
+    const vector<size_t>* StyleSheet::id_rules(const string& name) const {
+        uint32_t symbol = ids.find(name);
+        return symbol < rules_by_id.size() ? &rules_by_id[symbol] : nullptr;
+    }
+
+    const Declarations& StyleSheet::declarations(size_t rule) const {
+        return rules[rule];
+    }
+
+    // Implementation for StyleCache
+    StyleCache::StyleCache(const StyleSheet& sheet) : sheet(sheet) {
+        intern(ComputedStyle());
+    }
+
+    const ComputedStyle* StyleCache::root() const {
+        return &styles.front();
+    }
+
+    size_t StyleCache::KeyHash::operator()(const pair<const ComputedStyle*, string>& key) const {
+        return (size_t) hash64(key.second.data(), key.second.size(), (uint64_t) (uintptr_t) key.first);
+    }
+
+    const ComputedStyle* StyleCache::intern(const ComputedStyle& style) {
+        uint64_t hash = 0;
+        for (const string& value : style.values) {
+            hash = hash64(value.data(), value.size(), hash);
+        }
+        vector<const ComputedStyle*>& bucket = by_hash[hash];
+        for (const ComputedStyle* stored : bucket) {
+            if (*stored == style) {
+                return stored;
+            }
+        }
+        styles.push_back(style);
+        bucket.push_back(&styles.back());
+        return &styles.back();
+    }
+
+    const ComputedStyle* StyleCache::compute(const ComputedStyle* parent,
+                                             const char* classes,
+                                             const char* id,
+                                             const Declarations& presentation,
+                                             const char* inline_style) {
+        bool hasClasses = classes != nullptr && classes[0] != '\0';
+        const vector<size_t>* idRules = id != nullptr ? sheet.id_rules(id) : nullptr;
+        bool ownDeclarations = !presentation.empty() || idRules != nullptr || inline_style != nullptr;
+        bool inheritsAll = true;
+        for (int p = 0; p < STYLE_PROPERTY_COUNT; p++) {
+            inheritsAll = inheritsAll && (isInherited(p) || parent->values[p].empty());
+        }
+        if (!ownDeclarations && (!hasClasses || sheet.empty()) && inheritsAll) {
+            return parent;
+        }
+
+        // Elements styled only through classes share their computed style
+        pair<const ComputedStyle*, string> key;
+        if (!ownDeclarations) {
+            key = make_pair(parent, string(hasClasses ? classes : ""));
+            auto it = by_classes.find(key);
+            if (it != by_classes.end()) {
+                return it->second;
+            }
+        }
+
+        ComputedStyle style = *parent;
+        for (int p = 0; p < STYLE_PROPERTY_COUNT; p++) {
+            if (!isInherited(p)) {
+                style.values[p].clear();
+            }
+        }
+        style.apply(presentation, *parent);
+        if (hasClasses && !sheet.empty()) {
+            matched.clear();
+            const char* p = classes;
+            while (*p) {
+                while (*p && isspace((unsigned char) *p)) {
+                    p++;
+                }
+                const char* q = p;
+                while (*q && !isspace((unsigned char) *q)) {
+                    q++;
+                }
+                if (q > p) {
+                    const vector<size_t>* rules = sheet.class_rules(string(p, q));
+                    if (rules) {
+                        matched.insert(matched.end(), rules->begin(), rules->end());
+                    }
+                }
+                p = q;
+            }
+            // Equal specificity: later rules win
+            sort(matched.begin(), matched.end());
+            for (size_t rule : matched) {
+                style.apply(sheet.declarations(rule), *parent);
+            }
+        }
+        if (idRules) {
+            for (size_t rule : *idRules) {
+                style.apply(sheet.declarations(rule), *parent);
+            }
+        }
+        if (inline_style) {
+            Declarations declarations;
+            parse_declarations(inline_style, declarations);
+            style.apply(declarations, *parent);
+        }
+
+        const ComputedStyle* result = intern(style);
+        if (!ownDeclarations) {
+            by_classes.emplace(move(key), result);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,198 @@
+#ifndef __svg_Style_hpp__
+#define __svg_Style_hpp__
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "IdTable.hpp"
+
+namespace svg
+{
+    /**
+     * @brief The style properties understood by the renderer, all inherited except opacity.
+     */
+    enum StyleProperty
+    {
+        FILL,              ///< fill
+        STROKE,            ///< stroke
+        STROKE_WIDTH,      ///< stroke-width
+        STROKE_LINEJOIN,   ///< stroke-linejoin
+        STROKE_LINECAP,    ///< stroke-linecap
+        STROKE_MITERLIMIT, ///< stroke-miterlimit
+        FILL_OPACITY,      ///< fill-opacity
+        STROKE_OPACITY,    ///< stroke-opacity
+        OPACITY,           ///< opacity (not inherited)
+        FILL_RULE,         ///< fill-rule
+        STYLE_PROPERTY_COUNT
+    };
+
+    /**
+     * @brief Finds a style property by name.
+     * @param name The property name, as in an attribute or a style sheet.
+     * @return The property, or STYLE_PROPERTY_COUNT if unknown.
+     */
+    StyleProperty find_style_property(const std::string &name);
+
+    /**
+     * @brief Parses an opacity value (a number, or a percentage).
+     * @param value The value; empty for the default.
+     * @return The opacity, clamped to [0, 1]; 1 by default.
+     */
+    double parse_opacity(const std::string &value);
+
+    /**
+     * @brief A property assignment, as in a style attribute or a style sheet rule.
+     */
+    struct Declaration
+    {
+        StyleProperty property; ///< The property.
+        std::string value; ///< The value, trimmed.
+    };
+
+    typedef std::vector<Declaration> Declarations; ///< Declarations in order of appearance.
+
+    /**
+     * @brief Parses the declarations of a style attribute or rule ("name: value; ...").
+     * @param text The text.
+     * @param declarations The vector to append the declarations of known properties to.
+     */
+    void parse_declarations(const std::string &text, Declarations &declarations);
+
+    /**
+     * @brief The values of all style properties of an element.
+     */
+    struct ComputedStyle
+    {
+        std::string values[STYLE_PROPERTY_COUNT]; ///< The values, by property; empty where unset.
+
+        /**
+         * @brief Gets a property value.
+         * @param property The property.
+         * @return The value, or an empty string if unset.
+         */
+        const std::string &get(StyleProperty property) const;
+        /**
+         * @brief Assigns the properties of a list of declarations, later ones winning.
+         * @param declarations The declarations.
+         * @param parent The style of the parent element, for "inherit" values.
+         */
+        void apply(const Declarations &declarations, const ComputedStyle &parent);
+        bool operator==(const ComputedStyle &other) const; ///< Equality of all values.
+    };
+
+    /**
+     * @brief The rules of the <style> elements of a document, with selectors compiled
+     * to class and id symbols.
+     *
+     * Only simple selectors (".class" and "#id", possibly grouped with commas) are
+     * supported; rules with other selectors are ignored.
+     */
+    class StyleSheet
+    {
+    public:
+        /**
+         * @brief Adds the rules of a style sheet.
+         * @param css The style sheet text.
+         */
+        void parse(const std::string &css);
+        /**
+         * @brief Checks if there are no rules.
+         * @return true if no rule was added.
+         */
+        bool empty() const;
+        /**
+         * @brief Finds the rules matching a class.
+         * @param name The class name.
+         * @return Indices of the rules, in ascending order, or nullptr if none.
+         */
+        const std::vector<size_t> *class_rules(const std::string &name) const;
+        /**
+         * @brief Finds the rules matching an id.
+         * @param name The id.
+         * @return Indices of the rules, in ascending order, or nullptr if none.
+         */
+        const std::vector<size_t> *id_rules(const std::string &name) const;
+        /**
+         * @brief Gets the declarations of a rule.
+         * @param rule The rule index.
+         * @return The declarations.
+         */
+        const Declarations &declarations(size_t rule) const;
+
+    private:
+        std::vector<Declarations> rules; ///< The declarations of each rule, in document order.
+        IdTable classes; ///< The class names used in selectors.
+        std::vector<std::vector<size_t>> rules_by_class; ///< The rules of each class, by symbol.
+        IdTable ids; ///< The ids used in selectors.
+        std::vector<std::vector<size_t>> rules_by_id; ///< The rules of each id, by symbol.
+    };
+
+    /**
+     * @brief Computes the styles of elements, interning the results.
+     *
+     * Equal styles are stored once, so they can be compared by address, and the
+     * style of an element that only has classes is memoized by (parent style,
+     * class attribute): documents that style everything through classes compute
+     * each distinct combination once.
+     * Precedence follows CSS: inherited values, then presentation attributes,
+     * then class rules, then id rules, then the style attribute.
+     */
+    class StyleCache
+    {
+    public:
+        /**
+         * @brief Constructor.
+         * @param sheet The style sheet of the document; must outlive the cache.
+         */
+        explicit StyleCache(const StyleSheet &sheet);
+        StyleCache(const StyleCache &) = delete;
+        StyleCache &operator=(const StyleCache &) = delete;
+
+        /**
+         * @brief Gets the style of the root element (all properties unset).
+         * @return The style.
+         */
+        const ComputedStyle *root() const;
+        /**
+         * @brief Computes the style of an element.
+         * @param parent The style of the parent element.
+         * @param classes The class attribute (whitespace-separated names), or nullptr.
+         * @param id The id attribute, or nullptr.
+         * @param presentation The presentation attributes (fill="..." etc.).
+         * @param inline_style The style attribute, or nullptr.
+         * @return The style, valid for the lifetime of the cache.
+         */
+        const ComputedStyle *compute(const ComputedStyle *parent,
+                                     const char *classes,
+                                     const char *id,
+                                     const Declarations &presentation,
+                                     const char *inline_style);
+
+    private:
+        /**
+         * @brief Returns the stored style equal to a style, storing it if new.
+         * @param style The style.
+         * @return The stored style.
+         */
+        const ComputedStyle *intern(const ComputedStyle &style);
+
+        /**
+         * @brief Hash of a (parent style, class attribute) pair.
+         */
+        struct KeyHash
+        {
+            size_t operator()(const std::pair<const ComputedStyle *, std::string> &key) const;
+        };
+
+        const StyleSheet &sheet; ///< The style sheet.
+        std::deque<ComputedStyle> styles; ///< The distinct styles (stable addresses).
+        std::unordered_map<uint64_t, std::vector<const ComputedStyle *>> by_hash; ///< Stored styles, by hash of their values.
+        std::unordered_map<std::pair<const ComputedStyle *, std::string>, const ComputedStyle *, KeyHash> by_classes; ///< Memoized class-only styles.
+        std::vector<size_t> matched; ///< Scratch rule indices.
+    };
+}
+
+#endif
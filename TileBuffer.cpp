@@ -0,0 +1,158 @@
+//! @file TileBuffer.cpp
+#include "TileBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace svg
+{
+    const int TileBuffer::TILE_SIZE;
+
+    static const Color WHITE = {255, 255, 255};
+
+    static bool is_white(const Color &c)
+    {
+        return c.red == 255 && c.green == 255 && c.blue == 255;
+    }
+
+    TileBuffer::TileBuffer(int w, int h)
+        : width_(w), columns_(((size_t)w + TILE_SIZE - 1) / TILE_SIZE), allocated_(0)
+    {
+        assert(w > 0 && h > 0);
+        tiles_.resize(columns_ * (((size_t)h + TILE_SIZE - 1) / TILE_SIZE));
+    }
+
+    void TileBuffer::clear()
+    {
+        for (std::unique_ptr<Color[]> &tile : tiles_)
+        {
+            tile.reset();
+        }
+        allocated_ = 0;
+    }
+
+    size_t TileBuffer::tile_index(int x, int y) const
+    {
+        return (size_t)(y / TILE_SIZE) * columns_ + (size_t)(x / TILE_SIZE);
+    }
+
+    Color *TileBuffer::writable(int x, int y)
+    {
+        std::unique_ptr<Color[]> &tile = tiles_[tile_index(x, y)];
+        if (!tile)
+        {
+            tile.reset(new Color[(size_t)TILE_SIZE * TILE_SIZE]);
+            std::memset(tile.get(), 0xFF, (size_t)TILE_SIZE * TILE_SIZE * sizeof(Color));
+            allocated_++;
+        }
+        return tile.get() + (size_t)(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE;
+    }
+
+    const Color *TileBuffer::readable(int x, int y) const
+    {
+        const std::unique_ptr<Color[]> &tile = tiles_[tile_index(x, y)];
+        if (!tile)
+        {
+            return nullptr;
+        }
+        return tile.get() + (size_t)(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE;
+    }
+
+    void TileBuffer::fill(int y, int x0, int x1, const Color &c)
+    {
+        bool white = is_white(c);
+        for (int x = x0; x <= x1;)
+        {
+            int end = std::min(x1 + 1, (x / TILE_SIZE + 1) * TILE_SIZE);
+            if (!white || readable(x, y) != nullptr)
+            {
+                Color *p = writable(x, y);
+                std::fill(p, p + (end - x), c);
+            }
+            x = end;
+        }
+    }
+
+    void TileBuffer::set_pixels(int y, int x0, int n, const Color *colors)
+    {
+        for (int x = x0; x < x0 + n;)
+        {
+            int end = std::min(x0 + n, (x / TILE_SIZE + 1) * TILE_SIZE);
+            const Color *src = colors + (x - x0);
+            if (readable(x, y) != nullptr || !std::all_of(src, src + (end - x), is_white))
+            {
+                std::copy(src, src + (end - x), writable(x, y));
+            }
+            x = end;
+        }
+    }
+
+    Color TileBuffer::get(int x, int y) const
+    {
+        const Color *p = readable(x, y);
+        return p != nullptr ? *p : WHITE;
+    }
+
+    void TileBuffer::expand(int y, int x0, int n, Color *out) const
+    {
+        for (int x = x0; x < x0 + n;)
+        {
+            int end = std::min(x0 + n, (x / TILE_SIZE + 1) * TILE_SIZE);
+            const Color *p = readable(x, y);
+            if (p != nullptr)
+            {
+                std::copy(p, p + (end - x), out + (x - x0));
+            }
+            else
+            {
+                std::fill(out + (x - x0), out + (end - x0), WHITE);
+            }
+            x = end;
+        }
+    }
+
+    void TileBuffer::row_runs(int y, std::vector<ColorRun> &out) const
+    {
+        out.clear();
+        for (int x = 0; x < width_;)
+        {
+            int end = std::min(width_, x + TILE_SIZE);
+            const Color *p = readable(x, y);
+            if (p == nullptr)
+            {
+                // White tile: one run, merged with a white run before it.
+                if (out.empty() || !is_white(out.back().color))
+                {
+                    out.push_back({x, WHITE});
+                }
+                x = end;
+                continue;
+            }
+            for (; x < end; x++, p++)
+            {
+                const Color &last = out.empty() ? *p : out.back().color;
+                if (out.empty() || p->red != last.red || p->green != last.green || p->blue != last.blue)
+                {
+                    out.push_back({x, *p});
+                }
+            }
+        }
+    }
+
+    size_t TileBuffer::memory() const
+    {
+        return tiles_.capacity() * sizeof(std::unique_ptr<Color[]>) +
+               allocated_ * (size_t)TILE_SIZE * TILE_SIZE * sizeof(Color);
+    }
+
+    Color *TileBuffer::address(int x, int y)
+    {
+        return writable(x, y);
+    }
+
+    size_t TileBuffer::tile_count() const
+    {
+        return allocated_;
+    }
+}
@@ -0,0 +1,97 @@
+//! @file TileBuffer.hpp
+#ifndef __svg_TileBuffer_hpp__
+#define __svg_TileBuffer_hpp__
+
+#include "PixelStore.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace svg
+{
+    //! Pixels stored in square tiles allocated on first write: tiles
+    //! never written hold no memory and are known to be white, so only
+    //! the area drawn on costs memory, and blank rows are encoded from
+    //! a single run without reading pixels. Sizes and offsets are 64-bit,
+    //! for canvases of billions of pixels.
+    class TileBuffer : public PixelStore
+    {
+    public:
+        //! Width and height of a tile, in pixels.
+        static const int TILE_SIZE = 64;
+
+        //! Constructor of a white buffer.
+        //! @param w Width.
+        //! @param h Height.
+        TileBuffer(int w, int h);
+        //! Set all pixels to white, releasing all tiles.
+        void clear() override;
+        //! Fill a span of a row; white spans do not allocate tiles.
+        //! @param y Y position.
+        //! @param x0 First X position (in the row).
+        //! @param x1 Last X position (in the row, at least x0).
+        //! @param c Color.
+        void fill(int y, int x0, int x1, const Color &c) override;
+        //! Set consecutive pixels of a row; white pixels do not allocate
+        //! tiles.
+        //! @param y Y position.
+        //! @param x0 First X position (in the row).
+        //! @param n Number of pixels (x0 + n at most the width).
+        //! @param colors Colors.
+        void set_pixels(int y, int x0, int n, const Color *colors) override;
+        //! Get a pixel.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Color.
+        Color get(int x, int y) const override;
+        //! Expand part of a row to pixels.
+        //! @param y Y position.
+        //! @param x0 First X position.
+        //! @param n Number of pixels.
+        //! @param out Output pixels.
+        void expand(int y, int x0, int n, Color *out) const override;
+        //! Get a row as runs; tiles not allocated give white runs.
+        //! @param y Y position.
+        //! @param out Output runs.
+        void row_runs(int y, std::vector<ColorRun> &out) const override;
+        //! Get the memory held by the tiles and the tile table.
+        //! @return Size in bytes.
+        size_t memory() const override;
+        //! Get the address of a pixel, allocating its tile.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Pointer to the pixel.
+        Color *address(int x, int y) override;
+        //! Get the number of allocated tiles.
+        //! @return Number of tiles.
+        size_t tile_count() const;
+
+    private:
+        //! Get the row of a tile holding a pixel, allocating the tile.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Pointer to pixel (x, y), followed by the rest of the
+        //!         tile row.
+        Color *writable(int x, int y);
+        //! Get the row of a tile holding a pixel, if allocated.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Pointer to pixel (x, y), or nullptr if the tile is white.
+        const Color *readable(int x, int y) const;
+        //! Index of the tile holding a pixel.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @return Index in tiles_.
+        size_t tile_index(int x, int y) const;
+
+        //! Width.
+        int width_;
+        //! Number of tile columns.
+        size_t columns_;
+        //! Tiles, row of tiles by row of tiles; nullptr for white tiles.
+        std::vector<std::unique_ptr<Color[]>> tiles_;
+        //! Number of allocated tiles.
+        size_t allocated_;
+    };
+}
+#endif
@@ -1,23 +1,36 @@
 #include <string>
-#include <vector>
-#include "SVGElements.hpp"
+#include "FramebufferPool.hpp"
+#include "Scene.hpp"
 
 namespace svg
 {
     void convert(const std::string &svg_file, const std::string &png_file)
     {
-        Point dimensions;
-        std::vector<SVGElement *> svg_elements;
-        readSVG(svg_file, dimensions, svg_elements);
-        PNGImage img(dimensions.x, dimensions.y);
-        for (SVGElement* e : svg_elements)
+        convert(svg_file, png_file, RenderOptions());
+    }
+
+    void convert(const std::string &svg_file,
+                 const std::string &png_file,
+                 const RenderOptions &options)
+    {
+        Scene scene(svg_file, options.cancel, options.parse_threads);
+        scene.admit(options.budget);
+        FramebufferPool &pool = FramebufferPool::shared();
+        PNGImage img = options.storage == PixelStorage::Dense
+                           ? pool.acquire(scene.dimensions().x, scene.dimensions().y)
+                           : PNGImage(scene.dimensions().x, scene.dimensions().y, options.storage);
+        scene.draw(img, options);
+        if (options.indexed_png)
         {
-            e->draw(img);
+            // Without a known palette, the image's own colors decide.
+            std::vector<Color> colors;
+            scene.palette(colors);
+            img.save_indexed(png_file, colors);
         }
-        img.save(png_file);
-        for (SVGElement* e  : svg_elements)
+        else
         {
-            delete e;
+            img.save(png_file);
         }
+        pool.release(std::move(img));
     }
-}
\ No newline at end of file
+}
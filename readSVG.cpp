@@ -1,10 +1,15 @@
 #include <iostream>
 #include "SVGElements.hpp"
+#include "Style.hpp"
+#include "Gradient.hpp"
 #include "external/tinyxml2/tinyxml2.h"
 #include <algorithm>
+#include <cmath>
+#include <deque>
+#include <exception>
 #include <sstream>
-#include <map>
 #include <memory>
+#include <thread>
 
 using namespace std;
 using namespace tinyxml2;
@@ -30,6 +35,206 @@ namespace svg
         return points;
     }
 
+    // Read the stroke-* properties of a computed style
+    StrokeStyle parse_stroke_style(const ComputedStyle& computed) {
+        StrokeStyle style;
+        if (!computed.get(STROKE_WIDTH).empty()) {
+            style.width = parse_stroke_width(computed.get(STROKE_WIDTH));
+        }
+        if (!computed.get(STROKE_MITERLIMIT).empty()) {
+            style.miter_limit = parse_miter_limit(computed.get(STROKE_MITERLIMIT));
+        }
+        if (!computed.get(STROKE_LINEJOIN).empty()) {
+            style.join = parse_line_join(computed.get(STROKE_LINEJOIN));
+        }
+        if (!computed.get(STROKE_LINECAP).empty()) {
+            style.cap = parse_line_cap(computed.get(STROKE_LINECAP));
+        }
+        return style;
+    }
+
+    // Resources referenced from anywhere in a document, collected before its
+    // elements are parsed (and then shared read-only by the parsing threads)
+    struct DocumentResources {
+        StyleSheet sheet; // Rules of the <style> elements
+        IdTable gradientIds; // Interned gradient ids
+        vector<shared_ptr<const Gradient>> gradients; // Gradients by id symbol
+
+        // Find a gradient, or nullptr if not defined
+        shared_ptr<const Gradient> gradient(const string& id) const {
+            uint32_t symbol = gradientIds.find(id);
+            return symbol < gradients.size() ? gradients[symbol] : nullptr;
+        }
+    };
+
+    // Read a paint property (fill or stroke); false if the element is not painted.
+    // Gradient references set gradient (and color to the fallback of single-stop gradients).
+    static bool parse_paint(const ComputedStyle& computed, StyleProperty property, const char* fallback,
+                            const DocumentResources& resources, Color& color, shared_ptr<const Gradient>& gradient) {
+        const string& value = computed.get(property);
+        string paint = value.empty() ? fallback : value;
+        if (paint.compare(0, 5, "url(#") == 0) {
+            size_t close = paint.find(')');
+            shared_ptr<const Gradient> target = resources.gradient(paint.substr(5, close - 5));
+            if (target && !target->stops.empty()) {
+                if (target->stops.size() == 1) {
+                    color = target->stops[0].color;
+                } else {
+                    gradient = target;
+                }
+                return true;
+            }
+            // Missing or empty gradient: use the fallback color, if any
+            paint = close == string::npos ? "" : paint.substr(close + 1);
+            paint.erase(0, paint.find_first_not_of(" \t\n"));
+            if (paint.empty()) {
+                return false;
+            }
+        }
+        if (paint == "none") {
+            return false;
+        }
+        color = parse_color(paint);
+        return true;
+    }
+
+    // Compute the style of an element from its parent's
+    static const ComputedStyle* computeStyle(XMLElement* element, const ComputedStyle* parent, StyleCache& styles) {
+        Declarations presentation;
+        for (const XMLAttribute* a = element->FirstAttribute(); a != nullptr; a = a->Next()) {
+            StyleProperty property = find_style_property(a->Name());
+            if (property != STYLE_PROPERTY_COUNT) {
+                presentation.push_back({property, a->Value()});
+            }
+        }
+        return styles.compute(parent, element->Attribute("class"), element->Attribute("id"), presentation, element->Attribute("style"));
+    }
+
+    // Parse a gradient coordinate: a number, or a percentage of extent
+    static double parseGradientLength(XMLElement* element, const char* name, double fallback, double extent) {
+        const char* value = element->Attribute(name);
+        if (value == nullptr) {
+            return fallback;
+        }
+        char* end;
+        double length = strtod(value, &end);
+        length = *end == '%' ? length / 100 * extent : length;
+        // "nan", "inf" and overflowing values are ignored.
+        return std::isfinite(length) ? length : fallback;
+    }
+
+    // Parse a <linearGradient> or <radialGradient> element; href names the gradient to take stops from
+    static Gradient parseGradient(XMLElement* element, const Point& dimensions, string& href) {
+        Gradient gradient;
+        gradient.radial = string(element->Name()) == "radialGradient";
+        const char* units = element->Attribute("gradientUnits");
+        gradient.user_space = units && string(units) == "userSpaceOnUse";
+        const char* spread = element->Attribute("spreadMethod");
+        if (spread && string(spread) == "reflect") {
+            gradient.spread = GradientSpread::Reflect;
+        } else if (spread && string(spread) == "repeat") {
+            gradient.spread = GradientSpread::Repeat;
+        }
+
+        // Percentages are fractions of the bounding box, or of the canvas in user space
+        double w = gradient.user_space ? dimensions.x : 1, h = gradient.user_space ? dimensions.y : 1;
+        double diagonal = sqrt((w * w + h * h) / 2);
+        if (gradient.radial) {
+            gradient.cx = parseGradientLength(element, "cx", 0.5 * w, w);
+            gradient.cy = parseGradientLength(element, "cy", 0.5 * h, h);
+            gradient.r = parseGradientLength(element, "r", 0.5 * diagonal, diagonal);
+            gradient.fx = parseGradientLength(element, "fx", gradient.cx, w);
+            gradient.fy = parseGradientLength(element, "fy", gradient.cy, h);
+        } else {
+            gradient.x1 = parseGradientLength(element, "x1", 0, w);
+            gradient.y1 = parseGradientLength(element, "y1", 0, h);
+            gradient.x2 = parseGradientLength(element, "x2", w, w);
+            gradient.y2 = parseGradientLength(element, "y2", 0, h);
+        }
+
+        for (XMLElement* stop = element->FirstChildElement("stop"); stop != nullptr; stop = stop->NextSiblingElement("stop")) {
+            GradientStop s;
+            s.offset = max(0.0, min(1.0, parseGradientLength(stop, "offset", 0, 1)));
+            if (!gradient.stops.empty()) {
+                s.offset = max(s.offset, gradient.stops.back().offset);
+            }
+            string color = stop->Attribute("stop-color") ? stop->Attribute("stop-color") : "black";
+            const char* style = stop->Attribute("style");
+            size_t pos = style ? string(style).find("stop-color") : string::npos;
+            if (pos != string::npos) {
+                string declaration = string(style).substr(pos);
+                size_t colon = declaration.find(':'), end = declaration.find(';');
+                if (colon != string::npos) {
+                    color = declaration.substr(colon + 1, end == string::npos ? string::npos : end - colon - 1);
+                    color.erase(0, color.find_first_not_of(" \t"));
+                    color.erase(color.find_last_not_of(" \t") + 1);
+                }
+            }
+            s.color = parse_color(color);
+            gradient.stops.push_back(s);
+        }
+
+        const char* link = element->Attribute("href") ? element->Attribute("href") : element->Attribute("xlink:href");
+        href = link && link[0] == '#' ? link + 1 : "";
+        return gradient;
+    }
+
+    // Collect the <style> and gradient elements at the top level or in a <defs> there
+    static void collectResources(XMLElement* root, const Point& dimensions, DocumentResources& resources,
+                                 vector<Gradient>& gradients, vector<string>& hrefs) {
+        for (XMLElement* child = root->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
+            string name = child->Name();
+            if (name == "defs") {
+                collectResources(child, dimensions, resources, gradients, hrefs);
+            } else if (name == "style" && child->GetText()) {
+                resources.sheet.parse(child->GetText());
+            } else if ((name == "linearGradient" || name == "radialGradient") && child->Attribute("id")) {
+                uint32_t symbol = resources.gradientIds.intern(child->Attribute("id"));
+                if (gradients.size() <= symbol) {
+                    gradients.resize(symbol + 1);
+                    hrefs.resize(symbol + 1);
+                }
+                gradients[symbol] = parseGradient(child, dimensions, hrefs[symbol]);
+            }
+        }
+    }
+
+    // Read the resources of a document
+    static void readResources(XMLElement* root, const Point& dimensions, DocumentResources& resources) {
+        vector<Gradient> gradients;
+        vector<string> hrefs;
+        collectResources(root, dimensions, resources, gradients, hrefs);
+        // Gradients without stops take those of the gradient they link to
+        for (uint32_t s = 0; s < gradients.size(); s++) {
+            uint32_t target = s;
+            for (int hops = 0; hops < 32 && gradients[target].stops.empty() && !hrefs[target].empty(); hops++) {
+                target = resources.gradientIds.find(hrefs[target]);
+                if (target >= gradients.size()) {
+                    break;
+                }
+            }
+            if (target < gradients.size()) {
+                gradients[s].stops = gradients[target].stops;
+            }
+        }
+        for (Gradient& gradient : gradients) {
+            resources.gradients.push_back(make_shared<const Gradient>(gradient));
+        }
+    }
+
+    // Minimum number of top-level elements given to each parsing thread
+    static const size_t MIN_ELEMENTS_PER_THREAD = 64;
+
+    // State shared by the elements of one document (or one run of top-level elements)
+    struct ParseContext {
+        explicit ParseContext(const DocumentResources& resources) : resources(resources), styles(resources.sheet) {}
+        const DocumentResources& resources; // Style sheet and gradients
+        StyleCache styles; // Computed styles of the elements
+        Definitions definitions; // Elements by id, with their own transformations only
+        size_t forward_references = 0; // <use> elements parsed before their target
+        const CancellationToken* cancel = nullptr;
+    };
+
     // Function to parse transformation operations and apply them to an SVG element
     template<typename T>
     void parseTransform(T& element, const string& transform, const Point& transformOrigin) {
@@ -46,22 +251,24 @@ namespace svg
                     replace(translateString.begin(), translateString.end(), ',', ' ');
                     istringstream iss(translateString);
                     iss >> x >> y;
-                    element.addTransformation([=, &element]() { element.translate({x, y}); });
+                    element.addTransformation(Transform::translate({x, y}));
                 }
             } else if (operation.find("rotate") != string::npos) {
                 int angle;
                 sscanf(operation.c_str(), "rotate(%d", &angle);
-                element.addTransformation([&element, angle, transformOrigin]() { element.rotate(transformOrigin, angle); });
+                element.addTransformation(Transform::rotate(transformOrigin, angle));
             } else if (operation.find("scale") != string::npos) {
                 int factor;
                 sscanf(operation.c_str(), "scale(%d", &factor);
-                element.addTransformation([&element, factor, transformOrigin]() { element.scale(transformOrigin, factor); });
+                element.addTransformation(Transform::scale(transformOrigin, factor));
             }
         }
     }
 
-    void parseSVGElement(XMLElement* element, const Point& transformOrigin, vector<SVGElement*>& svg_elements, map<string, unique_ptr<SVGElement>>& elementMap) {
+    void parseSVGElement(XMLElement* element, const Point& transformOrigin, const ComputedStyle* parentStyle, vector<SVGElement*>& svg_elements, ParseContext& context) {
+        check_cancelled(context.cancel);
         const string nodeName = element->Name();
+        const ComputedStyle* style = computeStyle(element, parentStyle, context.styles);
         const char* attrValue = element->Attribute("transform");
         string transform = attrValue ? attrValue : ""; // Use empty string if null
 
@@ -75,13 +282,14 @@ namespace svg
         if (nodeName == "g") {
             auto group = std::make_unique<SVGGroup>();
             group->id = element->Attribute("id") ? element->Attribute("id") : "";
+            group->opacity = parse_opacity(style->get(OPACITY));
             parseTransform(*group, transform, newTransformOrigin);
 
             // Process child elements of the group
             XMLElement* child = element->FirstChildElement();
             while (child != nullptr) {
                 vector<SVGElement*> childElements;
-                parseSVGElement(child, newTransformOrigin, childElements, elementMap);
+                parseSVGElement(child, newTransformOrigin, style, childElements, context);
                 for (auto& childElement : childElements) {
                     group->addElement(unique_ptr<SVGElement>(childElement));
                 }
@@ -90,88 +298,125 @@ namespace svg
 
             group->applyTransformations();
 
-            // Add the group to the SVG elements vector and element map
+            // Add the group to the SVG elements vector and the definitions
             if (!group->id.empty()) {
-                auto clonedGroup = group->clone();  // Clone before moving the unique_ptr to the map
-                svg_elements.push_back(clonedGroup.release());
-                elementMap[group->id] = std::move(group);
-            }
-            else {
-                svg_elements.push_back(group.release());
+                context.definitions.define(group->id, *group);
             }
+            svg_elements.push_back(group.release());
 
         } else if (nodeName == "use") {
             const char* href = element->Attribute("href");
             if (href && href[0] == '#') {
                 string id = href + 1; // Skip the '#' character
-                auto it = elementMap.find(id);
-                if (it != elementMap.end()) {
+                unique_ptr<SVGElement> instance;
+                const SVGElement* target = context.definitions.find(id);
+                if (target) {
                     // Clone the referenced element
-                    auto clonedElement = it->second->clone();
-                    clonedElement->setTransformOrigin(newTransformOrigin);
-                    parseTransform(*clonedElement, transform, newTransformOrigin);
-                    clonedElement->applyTransformations(); // Apply transformations immediately after parsing
-                    svg_elements.push_back(clonedElement.release());
+                    instance = target->clone();
+                } else {
+                    // Forward reference: resolved once the whole document is parsed
+                    instance = std::make_unique<Use>(id);
+                    context.forward_references++;
+                }
+                instance->opacity *= parse_opacity(style->get(OPACITY));
+                instance->setTransformOrigin(newTransformOrigin);
+                parseTransform(*instance, transform, newTransformOrigin);
+                instance->applyTransformations(); // Apply transformations immediately after parsing
+
+                const char* idAttr = element->Attribute("id");
+                if (idAttr) {
+                    instance->id = idAttr;
+                    context.definitions.define(instance->id, *instance);
                 }
+                svg_elements.push_back(instance.release());
             }
         } else {
             unique_ptr<SVGElement> newElement;
             // Determine SVG element type 
+            Color fillColor, strokeColor;
+            shared_ptr<const Gradient> gradient;
             if (nodeName == "ellipse") {
                 int cx = element->IntAttribute("cx");
                 int cy = element->IntAttribute("cy");
                 int rx = element->IntAttribute("rx");
                 int ry = element->IntAttribute("ry");
-                string fill = element->Attribute("fill");
-                Color fillColor = parse_color(fill);
 
                 Point center{cx, cy};
                 Point radius{rx, ry};
 
-                newElement = std::make_unique<Ellipse>(fillColor, center, radius);
+                if (parse_paint(*style, FILL, "black", context.resources, fillColor, gradient)) {
+                    newElement = std::make_unique<Ellipse>(fillColor, center, radius);
+                    newElement->opacity = parse_opacity(style->get(FILL_OPACITY));
+                }
             } else if (nodeName == "circle") {
                 int cx = element->IntAttribute("cx");
                 int cy = element->IntAttribute("cy");
                 int r = element->IntAttribute("r");
-                string fill = element->Attribute("fill");
-                Color fillColor = parse_color(fill);
 
-                newElement = std::make_unique<Circle>(fillColor, Point{cx, cy}, r);
+                if (parse_paint(*style, FILL, "black", context.resources, fillColor, gradient)) {
+                    newElement = std::make_unique<Circle>(fillColor, Point{cx, cy}, r);
+                    newElement->opacity = parse_opacity(style->get(FILL_OPACITY));
+                }
             } else if (nodeName == "polyline") {
-                string points_str = element->Attribute("points");
-                vector<Point> points = parse_points(points_str);
-                string stroke = element->Attribute("stroke");
-                Color strokeColor = parse_color(stroke);
+                const char* points_str = element->Attribute("points");
+                vector<Point> points = parse_points(points_str ? points_str : "");
 
-                newElement = std::make_unique<Polyline>(strokeColor, points);
+                if (parse_paint(*style, STROKE, "none", context.resources, strokeColor, gradient)) {
+                    newElement = std::make_unique<Polyline>(strokeColor, points, parse_stroke_style(*style));
+                    newElement->opacity = parse_opacity(style->get(STROKE_OPACITY));
+                }
             } else if (nodeName == "line") {
                 int x1 = element->IntAttribute("x1");
                 int y1 = element->IntAttribute("y1");
                 int x2 = element->IntAttribute("x2");
                 int y2 = element->IntAttribute("y2");
-                string stroke = element->Attribute("stroke") ? element->Attribute("stroke") : "black";
 
-                Color strokeColor = parse_color(stroke);
-                newElement = std::make_unique<Line>(strokeColor, Point{x1, y1}, Point{x2, y2});
+                // Lines without a stroke are drawn in black
+                if (parse_paint(*style, STROKE, "black", context.resources, strokeColor, gradient)) {
+                    newElement = std::make_unique<Line>(strokeColor, Point{x1, y1}, Point{x2, y2}, parse_stroke_style(*style));
+                    newElement->opacity = parse_opacity(style->get(STROKE_OPACITY));
+                }
             } else if (nodeName == "polygon") {
-                string points_str = element->Attribute("points");
-                vector<Point> points = parse_points(points_str);
-                string fill = element->Attribute("fill");
-                Color fillColor = parse_color(fill);
+                const char* points_str = element->Attribute("points");
+                vector<Point> points = parse_points(points_str ? points_str : "");
 
-                newElement = std::make_unique<Polygon>(fillColor, points);
+                if (parse_paint(*style, FILL, "black", context.resources, fillColor, gradient)) {
+                    newElement = std::make_unique<Polygon>(fillColor, points);
+                    newElement->opacity = parse_opacity(style->get(FILL_OPACITY));
+                }
             } else if (nodeName == "rect") {
                 int x = element->IntAttribute("x");
                 int y = element->IntAttribute("y");
                 int width = element->IntAttribute("width");
                 int height = element->IntAttribute("height");
-                string fill = element->Attribute("fill");
-                Color fillColor = parse_color(fill);
 
-                newElement = std::make_unique<Rectangle>(Point{x, y}, width, height, fillColor);
+                if (parse_paint(*style, FILL, "black", context.resources, fillColor, gradient)) {
+                    newElement = std::make_unique<Rectangle>(Point{x, y}, width, height, fillColor);
+                    newElement->opacity = parse_opacity(style->get(FILL_OPACITY));
+                }
+            } else if (nodeName == "path") {
+                const char* d = element->Attribute("d");
+                PathData data;
+                parse_path_data(d ? d : "", data); // Keeps the path up to the first error
+                PathPaint fill, stroke;
+                fill.painted = parse_paint(*style, FILL, "black", context.resources, fill.color, fill.gradient);
+                fill.opacity = parse_opacity(style->get(FILL_OPACITY));
+                stroke.painted = parse_paint(*style, STROKE, "none", context.resources, stroke.color, stroke.gradient);
+                stroke.opacity = parse_opacity(style->get(STROKE_OPACITY));
+                if (!data.empty() && (fill.painted || stroke.painted)) {
+                    newElement = std::make_unique<Path>(data, parse_fill_rule(style->get(FILL_RULE)), fill, stroke, parse_stroke_style(*style));
+                    if (fill.gradient || stroke.gradient) {
+                        newElement->gradientBox = newElement->bounds();
+                    }
+                }
             }
 
             if (newElement) {
+                newElement->opacity *= parse_opacity(style->get(OPACITY));
+                if (gradient) {
+                    newElement->gradient = gradient;
+                    newElement->gradientBox = newElement->bounds();
+                }
                 newElement->setTransformOrigin(newTransformOrigin);
                 parseTransform(*newElement, transform, newTransformOrigin);
                 newElement->applyTransformations(); // Apply transformations immediately after parsing
@@ -179,32 +424,141 @@ namespace svg
                 const char* idAttr = element->Attribute("id");
                 if (idAttr) {
                     newElement->id = idAttr;
-                    elementMap[newElement->id] = std::move(newElement);
-                } else {
-                    // If no ID, manage the element in the local vector
-                    svg_elements.push_back(newElement.release());
+                    context.definitions.define(newElement->id, *newElement);
+                }
+                svg_elements.push_back(newElement.release());
+            }
+        }
+    }
+
+    // A run of consecutive top-level elements, parsed on its own thread
+    struct ParseChunk {
+        explicit ParseChunk(const DocumentResources& resources) : context(resources) {}
+        vector<XMLElement*> nodes; // The XML elements of the run
+        vector<SVGElement*> elements; // The parsed elements (owned until stitched)
+        ParseContext context; // Definitions and forward references within the run
+        exception_ptr error; // The exception that stopped parsing, if any
+    };
+
+    // Parse the top-level elements in parallel and stitch them in document order.
+    // Each chunk is parsed as if it started the document, so <use> elements whose
+    // target comes from an earlier chunk are left unresolved; stitching resolves
+    // them against the definitions of the earlier chunks before adding the chunk's
+    // own, which gives the same copies as parsing the whole document in sequence.
+    static void parseParallel(XMLElement* root, const vector<XMLElement*>& nodes, const DocumentResources& resources, vector<SVGElement*>& svg_elements, const CancellationToken* cancel, size_t threads) {
+        deque<ParseChunk> chunks;
+        for (size_t t = 0; t < threads; t++) {
+            chunks.emplace_back(resources);
+            chunks[t].nodes.assign(nodes.begin() + nodes.size() * t / threads, nodes.begin() + nodes.size() * (t + 1) / threads);
+            chunks[t].context.cancel = cancel;
+        }
+        // tinyxml2 decodes attributes in place on first read, so the root is
+        // read here only; its style stays at a stable address in the first
+        // chunk's cache and is shared read-only by all chunks.
+        const ComputedStyle* style = computeStyle(root, chunks[0].context.styles.root(), chunks[0].context.styles);
+        vector<thread> workers;
+        for (size_t t = 1; t < threads; t++) {
+            workers.emplace_back([&chunks, style, t]() {
+                ParseChunk& chunk = chunks[t];
+                try {
+                    for (XMLElement* node : chunk.nodes) {
+                        parseSVGElement(node, {0, 0}, style, chunk.elements, chunk.context);
+                    }
+                } catch (...) {
+                    chunk.error = current_exception();
+                }
+            });
+        }
+        try {
+            for (XMLElement* node : chunks[0].nodes) {
+                parseSVGElement(node, {0, 0}, style, chunks[0].elements, chunks[0].context);
+            }
+        } catch (...) {
+            chunks[0].error = current_exception();
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+
+        exception_ptr error;
+        for (ParseChunk& chunk : chunks) {
+            if (chunk.error && !error) {
+                error = chunk.error;
+            }
+        }
+        if (error) {
+            for (ParseChunk& chunk : chunks) {
+                for (SVGElement* e : chunk.elements) {
+                    delete e;
                 }
             }
+            rethrow_exception(error);
+        }
+
+        Definitions definitions;
+        vector<string> resolving;
+        size_t forward_references = 0;
+        for (ParseChunk& chunk : chunks) {
+            if (chunk.context.forward_references > 0) {
+                for (SVGElement* e : chunk.elements) {
+                    e->resolveReferences(definitions, resolving);
+                }
+                chunk.context.definitions.resolveReferences(definitions);
+            }
+            forward_references += chunk.context.forward_references;
+            definitions.merge(std::move(chunk.context.definitions));
+            svg_elements.insert(svg_elements.end(), chunk.elements.begin(), chunk.elements.end());
+            chunk.elements.clear();
+        }
+        // References to elements later in the document, now all defined
+        if (forward_references > 0) {
+            for (SVGElement* e : svg_elements) {
+                e->resolveReferences(definitions, resolving);
+            }
         }
     }
 
-    void readSVG(const string& svg_file, Point& dimensions, vector<SVGElement*>& svg_elements) {
+    void readSVG(const string& svg_file, Point& dimensions, vector<SVGElement*>& svg_elements, const CancellationToken* cancel, unsigned threads) {
         XMLDocument doc;
         XMLError r = doc.LoadFile(svg_file.c_str());
         if (r != XML_SUCCESS) {
             throw runtime_error("Unable to load " + svg_file);
         }
         XMLElement* xml_elem = doc.RootElement();
-        map<string, unique_ptr<SVGElement>> elementMap;
 
         dimensions.x = xml_elem->IntAttribute("width");
         dimensions.y = xml_elem->IntAttribute("height");
+        DocumentResources resources;
+        readResources(xml_elem, dimensions, resources);
 
+        if (threads > 1) {
+            vector<XMLElement*> nodes;
+            for (XMLElement* child = xml_elem->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
+                nodes.push_back(child);
+            }
+            size_t chunks = min<size_t>(threads, nodes.size() / MIN_ELEMENTS_PER_THREAD);
+            if (chunks > 1) {
+                parseParallel(xml_elem, nodes, resources, svg_elements, cancel, chunks);
+                return;
+            }
+        }
+
+        ParseContext context(resources);
+        context.cancel = cancel;
+        const ComputedStyle* style = computeStyle(xml_elem, context.styles.root(), context.styles);
         XMLElement* child = xml_elem->FirstChildElement();
         while (child != nullptr) {
-            parseSVGElement(child, {0, 0}, svg_elements, elementMap);
+            parseSVGElement(child, {0, 0}, style, svg_elements, context);
             child = child->NextSiblingElement();
         }
+
+        // Second pass: copy the targets of forward references, now all defined
+        if (context.forward_references > 0) {
+            vector<string> resolving;
+            for (SVGElement* e : svg_elements) {
+                e->resolveReferences(context.definitions, resolving);
+            }
+        }
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,282 @@
+// Stress scene generator and scaling report
+#include "SVGElements.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// POSIX headers
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace svg
+{
+    const char *const COLORS[] = {"red", "green", "blue", "yellow", "black", "#800080", "#ffa500", "#808080"};
+
+    string random_color(mt19937 &rng)
+    {
+        return COLORS[rng() % (sizeof(COLORS) / sizeof(COLORS[0]))];
+    }
+
+    void svg_header(ofstream &out, long w, long h)
+    {
+        out << "<svg width=\"" << w << "\" height=\"" << h
+            << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+    }
+
+    // N random star-shaped polygons with V vertices each.
+    void generate_polygons(const string &file, int n, int v, int w, int h)
+    {
+        mt19937 rng(n * 7919 + v);
+        ofstream out(file);
+        svg_header(out, w, h);
+        int max_r = max(4, (int)sqrt((double)w * h / max(n, 1)));
+        for (int i = 0; i < n; i++)
+        {
+            int cx = rng() % w, cy = rng() % h, r = 2 + rng() % max_r;
+            out << "<polygon fill=\"" << random_color(rng) << "\" points=\"";
+            for (int k = 0; k < v; k++)
+            {
+                double a = 2 * M_PI * k / v, d = r * (0.5 + (rng() % 1000) / 2000.0);
+                out << (k ? " " : "") << lround(cx + d * cos(a)) << ',' << lround(cy + d * sin(a));
+            }
+            out << "\"/>\n";
+        }
+        out << "</svg>\n";
+    }
+
+    // Groups nested DEPTH levels deep, each with a transform and a shape.
+    void generate_nesting(const string &file, int depth)
+    {
+        mt19937 rng(depth);
+        ofstream out(file);
+        svg_header(out, 1024, 1024);
+        for (int i = 0; i < depth; i++)
+        {
+            const char *transform = i % 3 == 0 ? "translate(1,1)" : i % 3 == 1 ? "rotate(1)" : "translate(-1,0)";
+            out << "<g transform=\"" << transform << "\" transform-origin=\"512 512\">\n"
+                << "<rect x=\"" << 256 + i % 256 << "\" y=\"" << 256 + (i * 7) % 256
+                << "\" width=\"16\" height=\"16\" fill=\"" << random_color(rng) << "\"/>\n";
+        }
+        for (int i = 0; i < depth; i++)
+        {
+            out << "</g>\n";
+        }
+        out << "</svg>\n";
+    }
+
+    // One motif group and N <use> references to it, laid out in a grid.
+    void generate_uses(const string &file, int n)
+    {
+        int columns = max(1, (int)ceil(sqrt((double)n)));
+        ofstream out(file);
+        svg_header(out, columns * 20, columns * 20);
+        out << "<g id=\"motif\">\n"
+            << "<circle cx=\"8\" cy=\"8\" r=\"7\" fill=\"red\"/>\n"
+            << "<polygon fill=\"white\" points=\"8,2 13,13 2,13\"/>\n"
+            << "<line x1=\"0\" y1=\"16\" x2=\"16\" y2=\"16\" stroke=\"black\"/>\n"
+            << "</g>\n";
+        for (int i = 1; i < n; i++)
+        {
+            out << "<use href=\"#motif\" transform=\"translate(" << (i % columns) * 20
+                << ',' << (i / columns) * 20 << ")\"/>\n";
+        }
+        out << "</svg>\n";
+    }
+
+    // A W x H canvas with a few shapes spanning it.
+    void generate_canvas(const string &file, int w, int h)
+    {
+        ofstream out(file);
+        svg_header(out, w, h);
+        out << "<rect x=\"0\" y=\"0\" width=\"" << w << "\" height=\"" << h << "\" fill=\"yellow\"/>\n"
+            << "<ellipse cx=\"" << w / 2 << "\" cy=\"" << h / 2 << "\" rx=\"" << w / 3
+            << "\" ry=\"" << h / 3 << "\" fill=\"blue\"/>\n"
+            << "<polygon fill=\"red\" points=\"0," << h - 1 << ' ' << w / 2 << ",0 " << w - 1 << ','
+            << h - 1 << "\"/>\n"
+            << "<polyline stroke=\"black\" points=\"0,0 " << w - 1 << ',' << h - 1 << ' ' << w - 1
+            << ",0 0," << h - 1 << "\"/>\n"
+            << "</svg>\n";
+    }
+
+    // Measurements of one conversion, run in a child process.
+    struct Measurement
+    {
+        bool ok;
+        double seconds;
+        double peak_mb;
+    };
+
+    Measurement measure(const string &svg_file, const string &png_file)
+    {
+        Measurement m = {false, 0, 0};
+        auto start = chrono::steady_clock::now();
+        ::pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            try
+            {
+                convert(svg_file, png_file);
+            }
+            catch (const exception &e)
+            {
+                cerr << svg_file << ": " << e.what() << endl;
+                ::_exit(1);
+            }
+            ::_exit(0);
+        }
+        if (pid < 0)
+        {
+            perror("Unable to run conversion! Process creation failed!");
+            return m;
+        }
+        int status = -1;
+        struct rusage usage;
+        ::wait4(pid, &status, 0, &usage);
+        m.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        m.peak_mb = usage.ru_maxrss / 1024.0; // ru_maxrss is in KiB on Linux
+        m.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        return m;
+    }
+
+    // One sweep: a scene family and the parameter values to try.
+    struct Sweep
+    {
+        string name;
+        vector<long> values;
+    };
+
+    void run_report(const string &dir, long max_pixels)
+    {
+        ::mkdir(dir.c_str(), 0755);
+        vector<Sweep> sweeps = {
+            {"polygons", {100, 1000, 10000, 100000}},
+            {"vertices", {4, 32, 256, 2048}},
+            // tinyxml2 rejects documents nested deeper than 500 elements.
+            {"nesting", {10, 50, 250, 490}},
+            {"uses", {10, 100, 1000, 10000}},
+            {"canvas", {512, 1024, 2048, 4096, 8192, 16384, 32768}},
+        };
+        cout << left << setw(10) << "scene" << right << setw(10) << "param"
+             << setw(12) << "time(s)" << setw(12) << "peak(MB)"
+             << setw(10) << "param x" << setw(10) << "time x" << setw(10) << "mem x" << endl;
+        for (const Sweep &sweep : sweeps)
+        {
+            Measurement previous = {false, 0, 0};
+            long previous_value = 0;
+            for (long value : sweep.values)
+            {
+                string base = dir + "/" + sweep.name + "_" + to_string(value);
+                // Canvas sweeps grow in both dimensions; the parameter is the pixel count.
+                long param = sweep.name == "canvas" ? value * value : value;
+                if (sweep.name == "canvas" && param > max_pixels)
+                {
+                    break;
+                }
+                if (sweep.name == "polygons")
+                {
+                    generate_polygons(base + ".svg", value, 8, 2048, 2048);
+                }
+                else if (sweep.name == "vertices")
+                {
+                    generate_polygons(base + ".svg", 1000, value, 2048, 2048);
+                }
+                else if (sweep.name == "nesting")
+                {
+                    generate_nesting(base + ".svg", value);
+                }
+                else if (sweep.name == "uses")
+                {
+                    generate_uses(base + ".svg", value);
+                }
+                else
+                {
+                    generate_canvas(base + ".svg", value, value);
+                }
+                Measurement m = measure(base + ".svg", base + ".png");
+                cout << left << setw(10) << sweep.name << right << setw(10) << param
+                     << fixed << setprecision(3) << setw(12) << m.seconds
+                     << setprecision(1) << setw(12) << m.peak_mb;
+                if (previous.ok && m.ok)
+                {
+                    cout << setw(10) << (double)param / previous_value
+                         << setw(10) << m.seconds / previous.seconds
+                         << setw(10) << m.peak_mb / previous.peak_mb;
+                }
+                cout << (m.ok ? "" : "  FAILED") << endl;
+                previous = m;
+                previous_value = param;
+            }
+        }
+    }
+}
+
+int usage()
+{
+    cout << "Usage: stress generate polygons N V [W H] out.svg" << endl
+         << "       stress generate nesting DEPTH out.svg" << endl
+         << "       stress generate uses N out.svg" << endl
+         << "       stress generate canvas W H out.svg" << endl
+         << "       stress report [dir] [max_pixels]" << endl;
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    vector<string> args(argv + 1, argv + argc);
+    if (args.size() >= 1 && args[0] == "report")
+    {
+        string dir = args.size() >= 2 ? args[1] : "output/stress";
+        long max_pixels = args.size() >= 3 ? atol(args[2].c_str()) : 4096L * 4096;
+        svg::run_report(dir, max_pixels);
+        return 0;
+    }
+    if (args.size() < 4 || args[0] != "generate")
+    {
+        return usage();
+    }
+    const string &kind = args[1], &out = args.back();
+    // Sizes and counts must be positive (atoi gives 0 for non-numbers).
+    vector<int> numbers;
+    for (size_t i = 2; i + 1 < args.size(); i++)
+    {
+        numbers.push_back(atoi(args[i].c_str()));
+        if (numbers.back() <= 0)
+        {
+            return usage();
+        }
+    }
+    if (kind == "polygons" && (numbers.size() == 2 || numbers.size() == 4))
+    {
+        int w = numbers.size() == 4 ? numbers[2] : 2048;
+        int h = numbers.size() == 4 ? numbers[3] : 2048;
+        svg::generate_polygons(out, numbers[0], numbers[1], w, h);
+    }
+    else if (kind == "nesting" && numbers.size() == 1)
+    {
+        svg::generate_nesting(out, numbers[0]);
+    }
+    else if (kind == "uses" && numbers.size() == 1)
+    {
+        svg::generate_uses(out, numbers[0]);
+    }
+    else if (kind == "canvas" && numbers.size() == 2)
+    {
+        svg::generate_canvas(out, numbers[0], numbers[1]);
+    }
+    else
+    {
+        return usage();
+    }
+    return 0;
+}
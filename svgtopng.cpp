@@ -1,17 +1,118 @@
 #include "SVGElements.hpp"
+#include "Pipeline.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    svg::PipelineOptions options;
+    int first = 1;
+    while (first < argc && std::strncmp(argv[first], "--", 2) == 0)
     {
-        std::cout << "Usage: svgtopng in_file.svg out_file.png" << std::endl;
+        if (std::strcmp(argv[first], "--downscale") == 0)
+        {
+            options.render.budget.action = svg::RenderBudget::DOWNSCALE;
+            first += 1;
+        }
+        else if (std::strcmp(argv[first], "--indexed") == 0)
+        {
+            options.render.indexed_png = true;
+            first += 1;
+        }
+        else if (std::strcmp(argv[first], "--runs") == 0)
+        {
+            options.render.storage = svg::PixelStorage::Runs;
+            first += 1;
+        }
+        else if (std::strcmp(argv[first], "--tiles") == 0)
+        {
+            options.render.storage = svg::PixelStorage::Tiles;
+            first += 1;
+        }
+        else if (first + 1 < argc && std::strcmp(argv[first], "--blocks") == 0)
+        {
+            options.render.storage = std::atoi(argv[first + 1]) == 8 ? svg::PixelStorage::Blocks8
+                                                                     : svg::PixelStorage::Blocks16;
+            first += 2;
+        }
+        else if (first + 1 < argc && std::strcmp(argv[first], "--in-flight") == 0)
+        {
+            options.max_in_flight = std::max(1, std::atoi(argv[first + 1]));
+            first += 2;
+        }
+        else if (first + 1 < argc && std::strcmp(argv[first], "--timeout") == 0)
+        {
+            options.job_timeout = std::chrono::milliseconds(std::atol(argv[first + 1]));
+            first += 2;
+        }
+        else if (first + 1 < argc && std::strcmp(argv[first], "--parse-threads") == 0)
+        {
+            options.render.parse_threads = std::max(1, std::atoi(argv[first + 1]));
+            first += 2;
+        }
+        else if (first + 1 < argc && std::strcmp(argv[first], "--max-pixels") == 0)
+        {
+            // Limits both the canvas and the pixels visited by drawing.
+            options.render.budget.max_canvas_pixels = std::strtoull(argv[first + 1], nullptr, 10);
+            options.render.budget.max_pixels_touched = options.render.budget.max_canvas_pixels;
+            first += 2;
+        }
+        else
+        {
+            break;
+        }
     }
-    else
+    int files = argc - first;
+    if (files < 2 || files % 2 != 0)
+    {
+        std::cout << "Usage: svgtopng [options] in_file.svg out_file.png [in_2.svg out_2.png ...]" << std::endl
+                  << "Options: --in-flight N    framebuffers in flight when converting several files" << std::endl
+                  << "         --max-pixels N   reject scenes whose canvas or drawing exceeds N pixels" << std::endl
+                  << "         --downscale      scale such scenes down instead of rejecting them" << std::endl
+                  << "         --timeout MS     abandon each conversion still running MS milliseconds after it starts" << std::endl
+                  << "         --parse-threads N  threads parsing the elements of each file" << std::endl
+                  << "         --indexed        write images of at most 256 colors with a palette" << std::endl
+                  << "         --runs           store pixels as color runs (large, sparse canvases)" << std::endl
+                  << "         --tiles          allocate pixels in tiles on first write (huge canvases)" << std::endl
+                  << "         --blocks N       store pixels in NxN blocks, N = 8 or 16 (steep lines)" << std::endl;
+    }
+    else if (files == 2 && first == 1)
     {
         std::cout << "Performing conversion ... " << argv[1] << " --> " << argv[2] << std::endl;
-        svg::convert(argv[1], argv[2]);
+        try
+        {
+            svg::convert(argv[1], argv[2]);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << argv[1] << ": " << e.what() << std::endl;
+            return 1;
+        }
         std::cout << "Done!" << std::endl;
     }
+    else
+    {
+        std::vector<svg::ConversionJob> jobs;
+        for (int i = first; i < argc; i += 2)
+        {
+            jobs.push_back({argv[i], argv[i + 1]});
+        }
+        std::cout << "Performing " << jobs.size() << " conversions ..." << std::endl;
+        std::vector<svg::ConversionResult> results = svg::convert_all(jobs, options);
+        int failed = 0;
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            if (!results[i].ok)
+            {
+                failed++;
+                std::cout << jobs[i].svg_file << ": " << results[i].error << std::endl;
+            }
+        }
+        std::cout << "Done! " << (jobs.size() - failed) << " converted, " << failed << " failed." << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
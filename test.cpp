@@ -1,9 +1,14 @@
 
 // Project file headers
 #include "SVGElements.hpp"
+#include "FramebufferPool.hpp"
+#include "ImageDiff.hpp"
+#include "Pipeline.hpp"
+#include "Scene.hpp"
 
 // C++ library headers
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cassert>
 #include <iostream>
@@ -12,6 +17,9 @@
 #include <vector>
 #include <iterator>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
 using namespace std;
 
 // POSIX headers
@@ -19,10 +27,56 @@ using namespace std;
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <dirent.h>
+#include <sys/stat.h>
 
 namespace svg
 {
     const string LOG_FILE_NAME = "test_log.txt";
+    const string HASH_MANIFEST = "expected/hashes.txt";
+
+    // Manifest entry: hash of the decoded expected image, and the size of
+    // its PNG file (to notice when the file changes).
+    struct GoldenHash
+    {
+        long png_size;
+        uint64_t hash;
+    };
+
+    long file_size(const string &file)
+    {
+        struct stat st;
+        return ::stat(file.c_str(), &st) == 0 ? (long)st.st_size : -1;
+    }
+
+    // PNG color type from the IHDR chunk (2 for RGB, 3 for indexed), or -1.
+    int png_color_type(const string &file)
+    {
+        ifstream in(file, ios::binary);
+        char header[26];
+        return in.read(header, sizeof(header)) ? (unsigned char)header[25] : -1;
+    }
+
+    // Inputs of the encode and decode round trips, which the golden hashes
+    // skip: flat colors (indexed output) and a gradient of more than 256
+    // colors (indexed output falls back to RGB).
+    const char *const ROUND_TRIP_IDS[] = {"rect_2", "gradient_1"};
+    const int ROUND_TRIP_COLOR_TYPES[] = {3, 2};
+
+    // Input of the hit test: every painted element is reported by an id,
+    // nothing is painted white, and each opaque id paints one color.
+    const char *const HIT_TEST_ID = "group_8";
+    const struct
+    {
+        const char *element;
+        Color color;
+    } HIT_TEST_COLORS[] = {{"back", {0, 0, 255}}, {"pair", {255, 0, 0}}, {"top", {0, 255, 0}}, {"copy", {0, 255, 0}}};
+
+    // Input of the budget test: an 800x600 canvas of many polylines.
+    const char *const BUDGET_TEST_ID = "polyline_3";
+
+    // Input of the cancellation test: enough elements for parsing and
+    // drawing to poll the token many times.
+    const char *const CANCEL_TEST_ID = "lion";
 
     class TestDriver
     {
@@ -32,41 +86,396 @@ namespace svg
         int passed_tests = 0;
         int failed_tests = 0;
         FILE *log_stream;
+        bool use_hashes = false;
+        int tolerance = 0;
+        map<string, GoldenHash> manifest;
 
-        bool run_conversion_test(const string &id)
+        bool compare_images(const PNGImage &img1, const PNGImage &img2, const string &id)
         {
-            string svg_file = root_path + "/input/" + id + ".svg";
-            string exp_file = root_path + "/expected/" + id + ".png";
-            string out_file = root_path + "/output/" + id + ".png";
-            convert(svg_file, out_file);
-            PNGImage img1(exp_file), img2(out_file);
-            int w1 = img1.width(), h1 = img1.height(),
-                w2 = img2.width(), h2 = img2.height();
-            if (w1 != w2 || h1 != h2)
+            DiffOptions options;
+            options.tolerance = tolerance;
+            DiffResult result = diff(img1, img2, options);
+            if (!result.same_size)
             {
                 std::cout << "Images have different dimensions: "
-                          << w1 << "x" << h1 << " != "
-                          << w2 << "x" << h2 << endl;
+                          << img1.width() << "x" << img1.height() << " != "
+                          << img2.width() << "x" << img2.height() << endl;
                 return false;
             }
-            for (int i = 0; i < w1; i++)
+            if (result.max_delta > 0)
+            {
+                cout << result.mismatches << " pixels differ by more than " << tolerance
+                     << ", max channel delta " << result.max_delta
+                     << ", PSNR " << fixed << setprecision(2) << result.psnr << " dB" << endl;
+            }
+            if (!result.match())
             {
-                for (int j = 0; j < h1; j++)
+                Point p = result.first_mismatch;
+                Color c1 = img1.at(p.x, p.y), c2 = img2.at(p.x, p.y);
+                cout << "pixel (" << p.x << ' ' << p.y << "): expected "
+                     << (int)c1.red << ' ' << (int)c1.green << ' ' << (int)c1.blue
+                     << " got "
+                     << (int)c2.red << ' ' << (int)c2.green << ' ' << (int)c2.blue << std::endl;
+                options.heatmap_file = root_path + "/output/" + id + "_diff.png";
+                diff(img1, img2, options);
+                cout << "heatmap: " << options.heatmap_file << endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Parsing the top-level elements on several threads must give the
+        // same image as parsing them in sequence.
+        bool check_parallel_parse(const string &svg_file)
+        {
+            Scene sequential(svg_file), parallel(svg_file, nullptr, 4);
+            PNGImage img1(sequential.dimensions().x, sequential.dimensions().y);
+            PNGImage img2(parallel.dimensions().x, parallel.dimensions().y);
+            sequential.draw(img1);
+            parallel.draw(img2);
+            if (img1.hash() != img2.hash())
+            {
+                cout << "parsing with 4 threads changed the image" << endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Skipping the elements hidden by later opaque shapes must not
+        // change the image.
+        bool check_culling(const string &svg_file)
+        {
+            Scene scene(svg_file);
+            PNGImage img1(scene.dimensions().x, scene.dimensions().y);
+            PNGImage img2(scene.dimensions().x, scene.dimensions().y);
+            RenderOptions options;
+            scene.draw(img1, options);
+            options.cull_occluded = true;
+            scene.draw(img2, options);
+            if (img1.hash() != img2.hash())
+            {
+                cout << "culling occluded elements changed the image" << endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Renders regions of an input, and checks them against the same
+        // pixels of the whole image.
+        bool run_region_test(const string &id)
+        {
+            Scene scene(root_path + "/input/" + id + ".svg");
+            Point dims = scene.dimensions();
+            PNGImage full(dims.x, dims.y);
+            scene.draw(full);
+            // Odd offsets start row spans away from the shaders' chunks.
+            vector<BoundingBox> tiles = {
+                {{0, 0}, {dims.x - 1, dims.y - 1}},
+                {{dims.x / 3 + 1, dims.y / 4 + 3}, {dims.x * 2 / 3 + 4, dims.y * 3 / 4}},
+                {{37 % dims.x, 5 % dims.y}, {dims.x - 1, dims.y / 2}}};
+            // Tiles straddling the corners of the first, middle and last
+            // elements, which the spatial index must not miss.
+            const vector<const SVGElement *> &leaves = scene.leaves();
+            if (!leaves.empty())
+            {
+                for (size_t i : {(size_t)0, leaves.size() / 2, leaves.size() - 1})
+                {
+                    BoundingBox bounds = leaves[i]->bounds();
+                    for (const Point &corner : {bounds.min, bounds.max})
+                    {
+                        tiles.push_back({{corner.x - 7, corner.y - 7}, {corner.x + 8, corner.y + 8}});
+                    }
+                }
+            }
+            BoundingBox canvas = {{0, 0}, {dims.x - 1, dims.y - 1}};
+            for (BoundingBox tile : tiles)
+            {
+                tile = tile.intersection(canvas);
+                if (tile.empty())
+                {
+                    continue;
+                }
+                int w = tile.max.x - tile.min.x + 1, h = tile.max.y - tile.min.y + 1;
+                unique_ptr<PNGImage> region = scene.render_region(tile.min.x, tile.min.y, w, h);
+                for (int y = 0; y < h; y++)
                 {
-                    Color c1 = img1.at(i, j), c2 = img2.at(i, j);
-                    if (c1.red != c2.red || c1.green != c2.green || c1.blue != c2.blue)
+                    for (int x = 0; x < w; x++)
                     {
-                        cout << "pixel (" << i << ' ' << j << "): expected "
-                             << (int)c1.red << ' ' << (int)c1.green << ' ' << (int)c1.blue
-                             << " got "
-                             << (int)c2.red << ' ' << (int)c2.green << ' ' << (int)c2.blue << std::endl;
+                        Color c1 = full.at(tile.min.x + x, tile.min.y + y), c2 = region->at(x, y);
+                        if (c1.red != c2.red || c1.green != c2.green || c1.blue != c2.blue)
+                        {
+                            cout << "region " << tile.min.x << ',' << tile.min.y << ' ' << w << 'x' << h
+                                 << ", pixel (" << tile.min.x + x << ' ' << tile.min.y + y << "): expected "
+                                 << (int)c1.red << ' ' << (int)c1.green << ' ' << (int)c1.blue
+                                 << " got "
+                                 << (int)c2.red << ' ' << (int)c2.green << ' ' << (int)c2.blue << endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Checks element_at() and elements_in_rect() against the pixels of
+        // the hit test input: painted pixels have a hit, the topmost one,
+        // which has the color of the pixel unless it is translucent.
+        bool run_hit_test()
+        {
+            Scene scene(root_path + "/input/" + HIT_TEST_ID + ".svg");
+            Point dims = scene.dimensions();
+            PNGImage img(dims.x, dims.y);
+            scene.draw(img);
+            map<string, Color> colors;
+            for (const auto &entry : HIT_TEST_COLORS)
+            {
+                colors[entry.element] = entry.color;
+            }
+            vector<string> seen;
+            for (int y = 0; y < dims.y; y++)
+            {
+                for (int x = 0; x < dims.x; x++)
+                {
+                    Color c = img.at(x, y);
+                    bool painted = c.red != 255 || c.green != 255 || c.blue != 255;
+                    string hit = scene.element_at(x, y);
+                    vector<string> hits = scene.elements_in_rect(x, y, 1, 1);
+                    ostringstream error;
+                    if (painted != !hit.empty() || hits.empty() != hit.empty())
+                    {
+                        error << (painted ? "painted" : "white") << " pixel, element_at \"" << hit << "\", "
+                              << hits.size() << " elements_in_rect";
+                    }
+                    else if (painted && hits.back() != hit)
+                    {
+                        error << "element_at \"" << hit << "\", topmost of elements_in_rect \"" << hits.back() << '"';
+                    }
+                    else if (painted && colors.count(hit) != 0 &&
+                             (colors[hit].red != c.red || colors[hit].green != c.green || colors[hit].blue != c.blue))
+                    {
+                        error << "color " << (int)c.red << ' ' << (int)c.green << ' ' << (int)c.blue
+                              << " not painted by \"" << hit << '"';
+                    }
+                    if (!error.str().empty())
+                    {
+                        cout << "pixel (" << x << ' ' << y << "): " << error.str() << endl;
                         return false;
                     }
+                    for (const string &id : hits)
+                    {
+                        if (find(seen.begin(), seen.end(), id) == seen.end())
+                        {
+                            seen.push_back(id);
+                        }
+                    }
+                }
+            }
+            // The whole canvas holds every element hit at some pixel.
+            vector<string> all = scene.elements_in_rect(0, 0, dims.x, dims.y);
+            sort(seen.begin(), seen.end());
+            sort(all.begin(), all.end());
+            if (seen != all || seen.size() != 6)
+            {
+                cout << all.size() << " elements in the canvas, " << seen.size() << " hit at pixels" << endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Checks Scene::admit() on the budget test input: REJECT throws
+        // when the canvas or the vertices are over budget, DOWNSCALE zooms
+        // the canvas to fit and still rejects too many vertices.
+        bool run_budget_test()
+        {
+            string svg_file = root_path + "/input/" + BUDGET_TEST_ID + ".svg";
+            Scene scene(svg_file);
+            CostEstimate cost = scene.estimate_cost();
+            Point dims = scene.dimensions();
+            if (scene.admit(RenderBudget()) != 1 || scene.dimensions().x != dims.x || scene.dimensions().y != dims.y)
+            {
+                cout << "an unlimited budget changed the scene" << endl;
+                return false;
+            }
+            RenderBudget canvas, vertices, scaled_vertices;
+            canvas.max_canvas_pixels = cost.canvas_pixels / 4;
+            vertices.max_vertices = scaled_vertices.max_vertices = cost.vertices - 1;
+            scaled_vertices.action = RenderBudget::DOWNSCALE;
+            for (const RenderBudget &budget : {canvas, vertices, scaled_vertices})
+            {
+                try
+                {
+                    Scene over(svg_file);
+                    over.admit(budget);
+                    cout << "scene over budget admitted" << endl;
+                    return false;
+                }
+                catch (const BudgetExceeded &e)
+                {
+                    cout << "rejected: " << e.what() << endl;
+                }
+            }
+            // A quarter of the pixels: half the size, less 1% of margin.
+            canvas.action = RenderBudget::DOWNSCALE;
+            double factor = scene.admit(canvas);
+            Point scaled = scene.dimensions();
+            if (factor < 0.49 || factor > 0.5 || scaled.x != (int)(dims.x * factor) ||
+                scaled.y != (int)(dims.y * factor) || scene.estimate_cost().canvas_pixels > canvas.max_canvas_pixels)
+            {
+                cout << "downscaled by " << factor << " to " << scaled.x << 'x' << scaled.y << endl;
+                return false;
+            }
+            PNGImage img(scaled.x, scaled.y);
+            scene.draw(img);
+            return true;
+        }
+
+        // Checks that a cancelled token and a token past its deadline stop
+        // parsing, drawing, convert() and convert_all() with RenderCancelled
+        // and write no file. The sanitizers of the test build fail the test
+        // if the elements or buffers of an aborted render leak.
+        bool run_cancel_test()
+        {
+            string svg_file = root_path + "/input/" + CANCEL_TEST_ID + ".svg";
+            string out_file = root_path + "/output/" + CANCEL_TEST_ID + ".cancelled.png";
+            CancellationToken cancelled, expired;
+            cancelled.cancel();
+            expired.set_timeout(chrono::milliseconds(0));
+            for (const CancellationToken *token : {&cancelled, &expired})
+            {
+                string name = token == &cancelled ? "cancelled token" : "zero deadline";
+                ::unlink(out_file.c_str());
+                RenderOptions options;
+                options.cancel = token;
+                vector<string> missed;
+                try
+                {
+                    Scene scene(svg_file, token);
+                    missed.push_back("parsing");
+                }
+                catch (const RenderCancelled &)
+                {
+                }
+                Scene scene(svg_file);
+                PNGImage img(scene.dimensions().x, scene.dimensions().y);
+                try
+                {
+                    scene.draw(img, options);
+                    missed.push_back("drawing");
+                }
+                catch (const RenderCancelled &)
+                {
+                }
+                try
+                {
+                    convert(svg_file, out_file, options);
+                    missed.push_back("convert");
+                }
+                catch (const RenderCancelled &)
+                {
+                }
+                PipelineOptions pipeline;
+                pipeline.render = options;
+                for (const ConversionResult &result : convert_all({{svg_file, out_file}, {svg_file, out_file}}, pipeline))
+                {
+                    if (result.ok || result.error.find("render") != 0)
+                    {
+                        missed.push_back("convert_all");
+                    }
+                }
+                if (file_size(out_file) >= 0)
+                {
+                    missed.push_back("writing " + out_file);
+                }
+                for (const string &step : missed)
+                {
+                    cout << name << " did not stop " << step << endl;
+                }
+                if (!missed.empty())
+                {
+                    return false;
                 }
             }
             return true;
         }
 
+        bool run_conversion_test(const string &id)
+        {
+            string svg_file = root_path + "/input/" + id + ".svg";
+            string exp_file = root_path + "/expected/" + id + ".png";
+            string out_file = root_path + "/output/" + id + ".png";
+            if (!check_parallel_parse(svg_file) || !check_culling(svg_file))
+            {
+                return false;
+            }
+            if (!use_hashes)
+            {
+                convert(svg_file, out_file);
+                PNGImage img1(exp_file), img2(out_file);
+                return compare_images(img1, img2, id);
+            }
+            // Fast path: hash the framebuffer, skipping PNG encode and decode.
+            Scene scene(svg_file);
+            PNGImage img = FramebufferPool::shared().acquire(scene.dimensions().x, scene.dimensions().y);
+            scene.draw(img);
+            auto golden = manifest.find(id);
+            if (golden != manifest.end() &&
+                golden->second.png_size == file_size(exp_file) &&
+                golden->second.hash == img.hash())
+            {
+                cout << "golden hash matched" << endl;
+                return true;
+            }
+            cout << "golden hash missed, comparing pixels" << endl;
+            img.save(out_file);
+            PNGImage expected(exp_file);
+            return compare_images(expected, img, id);
+        }
+
+        // Converts the round-trip inputs with one pixel storage, through
+        // convert() and through the pipeline, and checks the decoded files
+        // against the expected images and their PNG color type.
+        bool run_round_trip_test(PixelStorage storage, const string &name, bool indexed)
+        {
+            PipelineOptions options;
+            options.render.storage = storage;
+            options.render.indexed_png = indexed;
+            vector<ConversionJob> jobs;
+            vector<string> ids, files;
+            for (const char *id : ROUND_TRIP_IDS)
+            {
+                string svg_file = root_path + "/input/" + id + ".svg";
+                string out_file = root_path + "/output/" + id + "." + name;
+                convert(svg_file, out_file + ".png", options.render);
+                jobs.push_back({svg_file, out_file + ".pipeline.png"});
+                ids.insert(ids.end(), 2, id);
+                files.push_back(out_file + ".png");
+                files.push_back(out_file + ".pipeline.png");
+            }
+            vector<ConversionResult> results = convert_all(jobs, options);
+            bool success = true;
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                if (!results[i].ok)
+                {
+                    cout << jobs[i].svg_file << ": " << results[i].error << endl;
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                int expected_type = indexed ? ROUND_TRIP_COLOR_TYPES[i / 2] : 2;
+                if (png_color_type(files[i]) != expected_type)
+                {
+                    cout << files[i] << ": color type " << png_color_type(files[i])
+                         << ", expected " << expected_type << endl;
+                    success = false;
+                }
+                PNGImage expected(root_path + "/expected/" + ids[i] + ".png"), img(files[i]);
+                success = compare_images(expected, img, ids[i]) && success;
+            }
+            return success;
+        }
+
         void onTestBegin(const string &id)
         {
             total_tests++;
@@ -88,7 +497,7 @@ namespace svg
             }
         }
 
-        void run_test(const string& id)
+        void run_test(const string& id, const function<bool()> &body)
         {
             int log_fd = ::fileno(log_stream);
             onTestBegin(id);
@@ -99,7 +508,7 @@ namespace svg
             
                 ::dup2(log_fd, 1);
                 ::dup2(log_fd, 2);
-                bool success = run_conversion_test(id);
+                bool success = body();
                 ::exit(success ? 0 : 1);
             }
             else if (pid > 0)
@@ -127,6 +536,69 @@ namespace svg
         {
         }
 
+        // Loads the golden hash manifest; returns false if there is none.
+        bool load_manifest()
+        {
+            ifstream in(root_path + "/" + HASH_MANIFEST);
+            string line;
+            while (getline(in, line))
+            {
+                istringstream fields(line);
+                string id;
+                GoldenHash entry;
+                if (fields >> id >> entry.png_size >> hex >> entry.hash)
+                {
+                    manifest[id] = entry;
+                }
+            }
+            use_hashes = !manifest.empty();
+            return use_hashes;
+        }
+
+        // Regenerates the golden hash manifest from the expected images.
+        void update_manifest()
+        {
+            string dir_path = root_path + "/expected";
+            ::DIR *directory = ::opendir(dir_path.c_str());
+            if (directory == nullptr)
+            {
+                cerr << "Unable to open expected directory " << dir_path << endl;
+                return;
+            }
+            vector<string> ids;
+            ::dirent *entry;
+            while ((entry = readdir(directory)) != nullptr)
+            {
+                string fname = entry->d_name;
+                size_t dot = fname.find_last_of('.');
+                if (entry->d_type == DT_REG && dot != string::npos && fname.substr(dot) == ".png")
+                {
+                    ids.push_back(fname.substr(0, dot));
+                }
+            }
+            ::closedir(directory);
+            sort(ids.begin(), ids.end());
+            ofstream out(root_path + "/" + HASH_MANIFEST);
+            for (const string &id : ids)
+            {
+                string exp_file = dir_path + "/" + id + ".png";
+                PNGImage img(exp_file);
+                out << id << ' ' << file_size(exp_file) << ' '
+                    << hex << setw(16) << setfill('0') << img.hash() << dec << '\n';
+            }
+            cout << "Wrote " << ids.size() << " hashes to " << HASH_MANIFEST << endl;
+        }
+
+        void disable_hashes()
+        {
+            use_hashes = false;
+        }
+
+        void set_tolerance(int value)
+        {
+            tolerance = value;
+        }
+
         void run_tests(const string &spec)
         {
             string dir_path = root_path + "/input";
@@ -136,31 +608,105 @@ namespace svg
                 cerr << "Unable to open input directory " << dir_path << endl;
                 return;
             }
-            vector<string> scripts_to_execute;
+            vector<string> scripts_to_execute, region_tests;
             ::dirent *entry;
             while ((entry = readdir(directory)) != nullptr)
             {
                 if (entry->d_type == DT_REG)
                 {
                     string fname = entry->d_name;
+                    string id = fname.substr(0, fname.find_last_of('.'));
                     if (fname.find(spec) == 0)
                     {
-                        scripts_to_execute.push_back(fname.substr(0, fname.find_last_of('.')));
+                        scripts_to_execute.push_back(id);
+                    }
+                    if (("region_" + id).find(spec) == 0)
+                    {
+                        region_tests.push_back(id);
                     }
                 }
             }
             ::closedir(directory);
-            if (scripts_to_execute.empty())
+            sort(scripts_to_execute.begin(), scripts_to_execute.end());
+            sort(region_tests.begin(), region_tests.end());
+
+            // Round trips through every pixel storage, with and without
+            // indexed output, named round_trip_<storage>[_indexed].
+            struct RoundTrip
+            {
+                string name;
+                PixelStorage storage;
+                bool indexed;
+            };
+            vector<RoundTrip> round_trips;
+            const pair<const char *, PixelStorage> storages[] = {
+                {"dense", PixelStorage::Dense},
+                {"runs", PixelStorage::Runs},
+                {"tiles", PixelStorage::Tiles},
+                {"blocks8", PixelStorage::Blocks8},
+                {"blocks16", PixelStorage::Blocks16}};
+            for (const auto &storage : storages)
+            {
+                for (bool indexed : {false, true})
+                {
+                    string name = string("round_trip_") + storage.first + (indexed ? "_indexed" : "");
+                    if (name.find(spec) == 0)
+                    {
+                        round_trips.push_back({name, storage.second, indexed});
+                    }
+                }
+            }
+            string hit_test = string("hit_") + HIT_TEST_ID;
+            if (hit_test.find(spec) != 0)
+            {
+                hit_test.clear();
+            }
+            string budget_test = string("budget_") + BUDGET_TEST_ID;
+            if (budget_test.find(spec) != 0)
+            {
+                budget_test.clear();
+            }
+            string cancel_test = string("cancel_") + CANCEL_TEST_ID;
+            if (cancel_test.find(spec) != 0)
+            {
+                cancel_test.clear();
+            }
+            if (scripts_to_execute.empty() && region_tests.empty() && hit_test.empty() && budget_test.empty() &&
+                cancel_test.empty() && round_trips.empty())
             {
                 cout << "No scripts matched the spec: " << spec << endl;
                 return;
             }
-            sort(scripts_to_execute.begin(), scripts_to_execute.end());
 
-            cout << "== " << scripts_to_execute.size() << " tests to execute  ==" << endl;
+            cout << "== "
+                 << scripts_to_execute.size() + region_tests.size() + !hit_test.empty() + !budget_test.empty() +
+                        !cancel_test.empty() + round_trips.size()
+                 << " tests to execute"
+                 << (use_hashes ? " (golden hashes)" : "") << "  ==" << endl;
             for (string id : scripts_to_execute)
             {
-                run_test(id);
+                run_test(id, [this, id]() { return run_conversion_test(id); });
+            }
+            for (string id : region_tests)
+            {
+                run_test("region_" + id, [this, id]() { return run_region_test(id); });
+            }
+            if (!hit_test.empty())
+            {
+                run_test(hit_test, [this]() { return run_hit_test(); });
+            }
+            if (!budget_test.empty())
+            {
+                run_test(budget_test, [this]() { return run_budget_test(); });
+            }
+            if (!cancel_test.empty())
+            {
+                run_test(cancel_test, [this]() { return run_cancel_test(); });
+            }
+            for (const RoundTrip &t : round_trips)
+            {
+                string name = t.name.substr(string("round_trip_").size());
+                run_test(t.name, [this, t, name]() { return run_round_trip_test(t.storage, name, t.indexed); });
             }
 
             cout << "== TEST EXECUTION SUMMARY ==" << endl
@@ -174,10 +720,44 @@ namespace svg
 
 int main(int argc, char **argv)
 {
-    --argc;
-    ++argv;
-    svg::TestDriver driver(argc == 2 ? argv[1] : ".");
-    string spec = argc >= 1 ? argv[0] : "";
+    // Options: --update-hashes regenerates the golden hash manifest and
+    // exits; --no-hash always compares decoded PNG files; --tolerance N
+    // accepts channel differences up to N.
+    bool update_hashes = false, no_hash = false;
+    int tolerance = 0;
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--update-hashes")
+        {
+            update_hashes = true;
+        }
+        else if (arg == "--no-hash")
+        {
+            no_hash = true;
+        }
+        else if (arg == "--tolerance" && i + 1 < argc)
+        {
+            tolerance = atoi(argv[++i]);
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+    svg::TestDriver driver(args.size() == 2 ? args[1] : ".");
+    if (update_hashes)
+    {
+        driver.update_manifest();
+        return 0;
+    }
+    if (!driver.load_manifest() || no_hash)
+    {
+        driver.disable_hashes();
+    }
+    driver.set_tolerance(tolerance);
+    string spec = args.size() >= 1 ? args[0] : "";
     driver.run_tests(spec);
 
     return 0;
@@ -1,37 +1,198 @@
 #include "external/tinyxml2/tinyxml2.h"
+#include "Scene.hpp"
 
 using namespace tinyxml2;
 
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <string>
+#include <vector>
 
-void dump(XMLElement *elem, int indentation)
+// Output is collected here and written in large blocks, without flushing per line.
+std::string out;
+
+void write_out(bool force)
 {
-    for (int i = 0; i < indentation; i++)
-        std::cout << " ";
+    if (force || out.size() >= (1 << 16))
+    {
+        ::fwrite(out.data(), 1, out.size(), stdout);
+        out.clear();
+    }
+}
 
-    std::cout << elem->Name() << " --> [";
+void dump(XMLElement *elem, int indentation)
+{
+    out.append(indentation, ' ');
+    out += elem->Name();
+    out += " --> [";
 
     for (const XMLAttribute *attr = elem->FirstAttribute(); attr != nullptr; attr = attr->Next())
-        std::cout << " " << attr->Name() << "=\"" << attr->Value() << "\"";
+    {
+        out += ' ';
+        out += attr->Name();
+        out += "=\"";
+        out += attr->Value();
+        out += '"';
+    }
 
-    std::cout << " ] " << std::endl;
+    out += " ] \n";
+    write_out(false);
     for (XMLElement *child = elem->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
     {
         dump(child, indentation + 2);
     }
 }
 
+// Statistics gathered from the XML tree.
+struct Stats
+{
+    std::map<std::string, long> counts;
+    int max_depth = 0;
+    long vertices = 0;
+    std::map<std::string, long> use_fan_out;
+};
+
+// Count the points in a points attribute (pairs of numbers separated by
+// whitespace or commas), up to the first character that is not a number.
+long count_points(const char *points)
+{
+    long numbers = 0;
+    const char *p = points;
+    while (true)
+    {
+        while (std::isspace((unsigned char)*p) || *p == ',')
+        {
+            p++;
+        }
+        char *end;
+        std::strtod(p, &end);
+        if (end == p)
+        {
+            break;
+        }
+        numbers++;
+        p = end;
+    }
+    return numbers / 2;
+}
+
+void collect(XMLElement *elem, int depth, Stats &stats)
+{
+    std::string name = elem->Name();
+    stats.counts[name]++;
+    stats.max_depth = std::max(stats.max_depth, depth);
+    const char *points = elem->Attribute("points");
+    if (points && (name == "polygon" || name == "polyline"))
+    {
+        stats.vertices += count_points(points);
+    }
+    const char *href = elem->Attribute("href");
+    if (href && name == "use")
+    {
+        stats.use_fan_out[href[0] == '#' ? href + 1 : href]++;
+    }
+    for (XMLElement *child = elem->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
+    {
+        collect(child, depth + 1, stats);
+    }
+}
+
+void print_stats(const char *file, XMLElement *root)
+{
+    Stats stats;
+    collect(root, 0, stats);
+    char line[256];
+    out += "file: ";
+    out += file;
+    out += '\n';
+    out += "elements by type:\n";
+    for (const auto &count : stats.counts)
+    {
+        ::snprintf(line, sizeof(line), "  %-12s %ld\n", count.first.c_str(), count.second);
+        out += line;
+    }
+    ::snprintf(line, sizeof(line), "max nesting depth: %d\npolygon/polyline vertices: %ld\n",
+               stats.max_depth, stats.vertices);
+    out += line;
+    out += "use fan-out per id:\n";
+    std::vector<std::pair<long, std::string>> uses;
+    for (const auto &use : stats.use_fan_out)
+    {
+        uses.push_back({use.second, use.first});
+    }
+    std::sort(uses.rbegin(), uses.rend());
+    for (const auto &use : uses)
+    {
+        ::snprintf(line, sizeof(line), "  #%-11s %ld\n", use.second.c_str(), use.first);
+        out += line;
+    }
+
+    // Raster cost: pixels covered by the bounding boxes of the primitives
+    // the renderer would draw, after transforms and <use> expansion.
+    try
+    {
+        svg::Scene scene(file);
+        const svg::Point &dims = scene.dimensions();
+        svg::BoundingBox canvas = {{0, 0}, {dims.x - 1, dims.y - 1}};
+        double area = 0, visible = 0;
+        for (const svg::SVGElement *e : scene.leaves())
+        {
+            svg::BoundingBox box = e->bounds();
+            if (!box.empty())
+            {
+                area += (double)(box.max.x - box.min.x + 1) * (box.max.y - box.min.y + 1);
+            }
+            box = box.intersection(canvas);
+            if (!box.empty())
+            {
+                visible += (double)(box.max.x - box.min.x + 1) * (box.max.y - box.min.y + 1);
+            }
+        }
+        double pixels = (double)std::max(dims.x, 0) * std::max(dims.y, 0);
+        ::snprintf(line, sizeof(line),
+                   "canvas: %d x %d (%.0f pixels)\nprimitives drawn: %zu\n"
+                   "estimated raster cost (sum of bounding-box areas): %.0f pixels, %.0f on canvas (%.2fx canvas)\n",
+                   dims.x, dims.y, pixels, scene.leaves().size(), area, visible,
+                   pixels > 0 ? visible / pixels : 0.0);
+        out += line;
+    }
+    catch (const std::exception &e)
+    {
+        out += "raster cost unavailable: ";
+        out += e.what();
+        out += '\n';
+    }
+    write_out(true);
+}
+
 int main(int argc, char **argv)
 {
     XMLDocument doc;
-    if (argc != 2)
+    bool stats = argc == 3 && std::strcmp(argv[1], "--stats") == 0;
+    if (argc != 2 && !stats)
     {
-        std::cout << "Usage: xmldump filename";
+        std::cout << "Usage: xmldump [--stats] filename" << std::endl;
+        return 0;
+    }
+    const char *file = argv[argc - 1];
+    if (doc.LoadFile(file) != XML_SUCCESS || doc.RootElement() == nullptr)
+    {
+        std::cout << file << ": unable to load" << std::endl;
+        return 1;
+    }
+    if (stats)
+    {
+        print_stats(file, doc.RootElement());
     }
     else
     {
-        doc.LoadFile(argv[1]);
         dump(doc.RootElement(), 0);
+        write_out(true);
     }
     return 0;
-}
\ No newline at end of file
+}